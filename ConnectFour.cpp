@@ -4,12 +4,22 @@
 * all copies or substantial portions of the Software.
 */
 
+//the standard library's min and max, not the macros
+#define NOMINMAX
 #include <Windows.h>
 #include <wrl.h>
 #include <d2d1.h>
 #include <dwrite.h>
 #include <sstream>
 
+#include "ConnectFourCore.h"
+#include "ConnectFourFrameScheduler.h"
+#include "ConnectFourGameFlow.h"
+#include "ConnectFourParallelSolver.h"
+#include "ConnectFourPonder.h"
+#include "ConnectFourRecord.h"
+#include "ConnectFourScene.h"
+
 #pragma comment(lib, "d2d1")
 #pragma comment(lib, "dwrite")
 
@@ -89,248 +99,109 @@ LRESULT CALLBACK IdleProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept;
 
 
-char boardState[7][6];
-
-bool mouseClicked = false;
-
-int gameState = 0;
-
-int playerScore = 0;
-int CPUScore = 0;
-
-bool hilightWinningPieces = false;
-
-char fallingPieceColor = 0;
-int fallingPieceX;
-float fallingPiecePosY;
-int fallingPieceTargetY;
-
-LARGE_INTEGER GameFinishedTicks;
-LARGE_INTEGER CurrentTimerFinished;
-LARGE_INTEGER TickCountPrevious;
-LARGE_INTEGER FallingPieceSpeed;
-
-int windowWidth = 0;
-int windowHeight = 0;
-
-bool bGeometryIsValid = false;
-
-[[nodiscard]]
-bool CheckForWinner(int lastMoveX, int lastMoveY) noexcept
-{
-	char objectiveType = boardState[lastMoveX][lastMoveY];
-
-	//theoretical maximum of 20 piece win
-
-	int winningPieces[20][2];
-	int winningPieceCount = 0;
+//the menu, the board, the scores and the animations, stepped once a frame
+ConnectFour::GameState game;
 
-	bool winDetected = false;
+//a piece falls the height of the window every half second, CreateAssets() sets the rate in rows
+ConnectFour::GameTiming gameTiming;
 
+//what the last frame drew, so the next one only repaints what changed
+ConnectFour::Scene scene;
 
-	//vertical:
-	{
-		if (lastMoveY < 3)//make sure we're not checking out of bounds
-		{
-			if (boardState[lastMoveX][lastMoveY + 1] == objectiveType &&
-				boardState[lastMoveX][lastMoveY + 2] == objectiveType &&
-				boardState[lastMoveX][lastMoveY + 3] == objectiveType)
-			{
-				winningPieces[winningPieceCount][0] = lastMoveX;
-				winningPieces[winningPieceCount][1] = lastMoveY + 1;
-				winningPieceCount++;
+//the book, the weights and the table are declared before the solvers that read them, so
+//they are destroyed after them: the ponderer's worker may still be searching when WinMain
+//returns, and its destructor stops and joins it while the book is still mapped
 
-				winningPieces[winningPieceCount][0] = lastMoveX;
-				winningPieces[winningPieceCount][1] = lastMoveY + 2;
-				winningPieceCount++;
+//positions in the book are played without searching
+ConnectFour::OpeningBook openingBook;
 
-				winningPieces[winningPieceCount][0] = lastMoveX;
-				winningPieces[winningPieceCount][1] = lastMoveY + 3;
-				winningPieceCount++;
+//scores the positions a timed out search stops at, retrained weights are read from ConnectFour.eval next to the executable
+ConnectFour::EvalWeights evalWeights = ConnectFour::EvalWeights::Default();
 
-				winDetected = true;
-			}
-		}
-	}
+//the transposition table is the only memory the engine allocates
+constexpr size_t EngineMemoryBytes = 64 << 20;
 
-	//horizontal:
-	{
-		int winningPiecesBookmark = winningPieceCount;
-		int sequentialPieces = 0;
+ConnectFour::TranspositionTable transpositionTable(EngineMemoryBytes);
+//the UI thread searches too, so every core works on the CPU move
+ConnectFour::ParallelSolver solver(transpositionTable, std::thread::hardware_concurrency());
 
-		//left
-		for (int i = 1; i < lastMoveX + 1; i++)
-		{
-			if (boardState[lastMoveX - i][lastMoveY] == objectiveType)
-			{
-				winningPieces[winningPieceCount][0] = lastMoveX - i;
-				winningPieces[winningPieceCount][1] = lastMoveY;
-				
-				winningPieceCount++;
-				sequentialPieces++;
-			}
-			else
-			{
-				break;
-			}
-		}
+//searches on a worker thread while pieces fall and while the player thinks
+ConnectFour::Ponderer ponderer(transpositionTable);
 
-		//right
-		for (int i = 1; i < 6 - lastMoveX + 1; i++)
-		{
-			if (boardState[lastMoveX + i][lastMoveY] == objectiveType)
-			{
-				winningPieces[winningPieceCount][0] = lastMoveX + i;
-				winningPieces[winningPieceCount][1] = lastMoveY;
+//the CPU move is searched on the UI thread, so it has to be back within about a frame.
+//positions the search can not finish in time get the move of its deepest completed iteration
+constexpr auto CPUMoveTimeLimit = std::chrono::milliseconds(15);
 
-				winningPieceCount++;
-				sequentialPieces++;
-			}
-			else
-			{
-				break;
-			}
-		}
+//every game is appended to the archive when it ends, or when Escape abandons it
+ConnectFour::GameWriter gameArchive;
 
-		if (sequentialPieces >= 3)
-		{
-			winDetected = true;
-		}
-		else
-		{
-			winningPieceCount = winningPiecesBookmark;
-		}
-	}
-
-	// "\"
-	{
-		int winningPiecesBookmark = winningPieceCount;
-		int sequentialPieces = 0;
-
-		{
-			//upward scan
-			int scanLength = min(lastMoveX, lastMoveY);
-
-			for (int i = 0; i < scanLength; i++)
-			{
-				if (boardState[lastMoveX - (i + 1)][lastMoveY - (i + 1)] == objectiveType)
-				{
-					winningPieces[winningPieceCount][0] = lastMoveX - (i + 1);
-					winningPieces[winningPieceCount][1] = lastMoveY - (i + 1);
-
-					winningPieceCount++;
-					sequentialPieces++;
-				}
-				else
-				{
-					break;
-				}
-			}
-		}
-
-		{
-			//downward scan
-			int scanLength = min(6 - lastMoveX, 5 - lastMoveY);
-
-			for (int i = 0; i < scanLength; i++)
-			{
-				if (boardState[lastMoveX + (i + 1)][lastMoveY + (i + 1)] == objectiveType)
-				{
-					winningPieces[winningPieceCount][0] = lastMoveX + (i + 1);
-					winningPieces[winningPieceCount][1] = lastMoveY + (i + 1);
+bool mouseClicked = false;
+bool escapePressed = false;
+//set while TrackMouseEvent() is asked to report the cursor leaving the window
+bool trackingMouse = false;
 
-					winningPieceCount++;
-					sequentialPieces++;
-				}
-				else
-				{
-					break;
-				}
-			}
-		}
+//frames are only drawn when something changed or an animation needs one, otherwise the
+//message loop sleeps
+ConnectFour::FrameScheduler frameScheduler;
 
-		if (sequentialPieces >= 3)
-		{
-			winDetected = true;
-		}
-		else
-		{
-			winningPieceCount = winningPiecesBookmark;
-		}
-	}
-	
-	// "/"
-	{
-		int winningPiecesBookmark = winningPieceCount;
-		int sequentialPieces = 0;
-
-		{
-			//upward scan
-			int scanLength = min(6 - lastMoveX, lastMoveY);
+//archiving is best effort, a game that can not be written is only lost from the archive
+void ArchiveGame(const ConnectFour::GameRecord& record) noexcept
+{
+	if (record.moveCount == 0)
+		return;
 
-			for (int i = 0; i < scanLength; i++)
-			{
-				if (boardState[lastMoveX + (i + 1)][lastMoveY - (i + 1)] == objectiveType)
-				{
-					winningPieces[winningPieceCount][0] = lastMoveX + (i + 1);
-					winningPieces[winningPieceCount][1] = lastMoveY - (i + 1);
+	(void)gameArchive.Write(record);
+	(void)gameArchive.Flush();
+}
 
-					winningPieceCount++;
-					sequentialPieces++;
-				}
-				else
-				{
-					break;
-				}
-			}
-		}
+//the game flow runs on the same clock as the frame scheduler
+[[nodiscard]]
+std::chrono::nanoseconds GameClock() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+}
 
-		{
-			//downward scan
-			int scanLength = min(lastMoveX, 5 - lastMoveY);
+int windowWidth = 0;
+int windowHeight = 0;
+UINT windowDpi = 96;
 
-			for (int i = 0; i < scanLength; i++)
-			{
-				if (boardState[lastMoveX - (i + 1)][lastMoveY + (i + 1)] == objectiveType)
-				{
-					winningPieces[winningPieceCount][0] = lastMoveX - (i + 1);
-					winningPieces[winningPieceCount][1] = lastMoveY + (i + 1);
+//the size the render target was made or last resized to
+D2D1_SIZE_U renderTargetSize = {};
 
-					winningPieceCount++;
-					sequentialPieces++;
-				}
-				else
-				{
-					break;
-				}
-			}
-		}
+bool bGeometryIsValid = false;
 
-		if (sequentialPieces >= 3)
-		{
-			winDetected = true;
-		}
-		else
-		{
-			winningPieceCount = winningPiecesBookmark;
-		}
-	}
+//the same colors the thumbnail renderer uses
+D2D1::ColorF BrushColor(ConnectFour::SceneBrush sceneBrush) noexcept
+{
+	const ConnectFour::SceneColor& color = ConnectFour::SceneColors[(int)sceneBrush];
+	return D2D1::ColorF(color.r, color.g, color.b);
+}
 
-	if (winDetected)
-	{
-		for (int i = 0; i < winningPieceCount; i++)
-		{
-			boardState[winningPieces[i][0]][winningPieces[i][1]] = objectiveType + 2;
-		}
+[[nodiscard]]
+ComPtr<IDWriteTextFormat> CreateTextFormat(float fontSize) noexcept
+{
+	ComPtr<IDWriteTextFormat> textFormat;
 
-		boardState[lastMoveX][lastMoveY] = objectiveType + 2;
+	FATAL_ON_FAIL(pDWriteFactory->CreateTextFormat(
+		L"Segoe UI",
+		NULL,
+		DWRITE_FONT_WEIGHT_NORMAL,
+		DWRITE_FONT_STYLE_NORMAL,
+		DWRITE_FONT_STRETCH_NORMAL,
+		fontSize,
+		L"en-us",
+		&textFormat
+	));
 
-		return true;
-	}
+	FATAL_ON_FAIL(textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER));
 
-	return false;
+	return textFormat;
 }
 
+//brings everything that depends on the window up to date, and does nothing when neither the
+//size nor the DPI changed, so a burst of WM_SIZE and WM_DPICHANGED costs one rebuild. the
+//render target is made once and resized after that, the brushes live as long as it does, and
+//the layout, the board geometry and the text formats follow the layout's key
 void CreateAssets() noexcept
 {
 	RECT ClientRect;
@@ -338,252 +209,200 @@ void CreateAssets() noexcept
 
 	D2D1_SIZE_U size = D2D1::SizeU(ClientRect.right, ClientRect.bottom);
 
-	FATAL_ON_FAIL(factory->CreateHwndRenderTarget(
-		D2D1::RenderTargetProperties(),
-		D2D1::HwndRenderTargetProperties(Window, size),
-		&renderTarget));
+	if (renderTarget == nullptr)
+	{
+		FATAL_ON_FAIL(factory->CreateHwndRenderTarget(
+			D2D1::RenderTargetProperties(),
+			//partial repaints draw over the last frame
+			D2D1::HwndRenderTargetProperties(Window, size, D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS),
+			&renderTarget));
 
-	renderTarget->SetDpi(96, 96);
+		renderTarget->SetDpi(96, 96);
 
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 1.0f, 0.0f), &brush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 1.0f), &PlayerBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 0.0f, 0.0f), &CPUBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(.564f, .564f, .564f), &GhostBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(0.5f, 0.5f, 1.0f), &PlayerWinBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 0.5f, 0.5f), &CPUWinBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::Board), &brush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::Player), &PlayerBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::CPU), &CPUBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::Ghost), &GhostBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::PlayerWin), &PlayerWinBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(BrushColor(ConnectFour::SceneBrush::CPUWin), &CPUWinBrush));
 
-	bGeometryIsValid = false;
-	
-	FATAL_ON_FAIL(pDWriteFactory->CreateTextFormat(
-		L"Segoe UI",
-		NULL,
-		DWRITE_FONT_WEIGHT_NORMAL,
-		DWRITE_FONT_STYLE_NORMAL,
-		DWRITE_FONT_STRETCH_NORMAL,
-		.12f * windowHeight,
-		L"en-us",
-		&TitleTextFormat
-	));
+		renderTargetSize = size;
+	}
+	else if (size.width != renderTargetSize.width || size.height != renderTargetSize.height)
+	{
+		FATAL_ON_FAIL(renderTarget->Resize(size));
+		renderTargetSize = size;
+	}
 
-	FATAL_ON_FAIL(TitleTextFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER));
+	if (scene.Layout().Matches(windowWidth, windowHeight, windowDpi))
+		return;
 
-	FATAL_ON_FAIL(pDWriteFactory->CreateTextFormat(
-		L"Segoe UI",
-		NULL,
-		DWRITE_FONT_WEIGHT_NORMAL,
-		DWRITE_FONT_STYLE_NORMAL,
-		DWRITE_FONT_STRETCH_NORMAL,
-		.08f * windowHeight,
-		L"en-us",
-		&MainTextFormat
-	));
+	scene.Resize(windowWidth, windowHeight, windowDpi);
 
-	FATAL_ON_FAIL(MainTextFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER));
+	const ConnectFour::SceneLayout& layout = scene.Layout();
 
-	FATAL_ON_FAIL(pDWriteFactory->CreateTextFormat(
-		L"Segoe UI",
-		NULL,
-		DWRITE_FONT_WEIGHT_NORMAL,
-		DWRITE_FONT_STYLE_NORMAL,
-		DWRITE_FONT_STRETCH_NORMAL,
-		.05f * windowHeight,
-		L"en-us",
-		&CopyrightTextFormat
-	));
+	bGeometryIsValid = false;
+
+	//the board is 80% of the window wide, a piece falls the window's height in half a second
+	gameTiming.fallRowsPerSecond = windowHeight / layout.squareSize / .5f;
 
-	FATAL_ON_FAIL(CopyrightTextFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER));
+	TitleTextFormat = CreateTextFormat(layout.titleFontSize);
+	MainTextFormat = CreateTextFormat(layout.mainFontSize);
+	CopyrightTextFormat = CreateTextFormat(layout.copyrightFontSize);
 }
 
-void DrawMenu() noexcept
+//the cursor and the clicks since the last frame, in the terms the game flow takes them
+ConnectFour::GameInput ReadInput() noexcept
 {
-	if (renderTarget == nullptr)
+	ConnectFour::GameInput input =
 	{
-		CreateAssets();
-	}
-
-	renderTarget->BeginDraw();
-	renderTarget->Clear();
+		.click = mouseClicked,
+		.escape = escapePressed
+	};
 
-	{
-		//title
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .1f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"CONNECT FOUR", 12, TitleTextFormat.Get(), textArea, PlayerBrush.Get());
-	}
+	mouseClicked = false;
+	escapePressed = false;
 
 	POINT cursorPos;
 	FATAL_ON_FALSE(GetCursorPos(&cursorPos));
 	FATAL_ON_FALSE(ScreenToClient(Window, &cursorPos));
 
-	{
-		//play button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .3f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"PLAY", 4, MainTextFormat.Get(), textArea, GhostBrush.Get());
-	}
+	const ConnectFour::SceneLayout& layout = scene.Layout();
 
-	{
-		//exit button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .45f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"EXIT", 4, MainTextFormat.Get(), textArea, GhostBrush.Get());
-	}
+	input.button = layout.ButtonAt((float)cursorPos.x, (float)cursorPos.y);
+	input.column = layout.ColumnAt((float)cursorPos.x);
 
+	return input;
+}
+
+//the move the CPU plays, the game flow only asks for one on the CPU's turn
+int CPUMove() noexcept
+{
+	int boardColumn;
+
+	//book moves are a lookup, a finished background search can be used as is, everything else is searched
+	if (!openingBook.BestMove(game.board, boardColumn) && !ponderer.TakeResult(game.board, boardColumn))
 	{
-		//copyright
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .9f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * 1.f
-		};
-		renderTarget->DrawTextW(L"\u24B8 2023 badasahog. All Rights Reserved", 37, CopyrightTextFormat.Get(), textArea, GhostBrush.Get());
+		ConnectFour::SearchLimits limits = { .deadline = std::chrono::steady_clock::now() + CPUMoveTimeLimit };
+
+		//a full board is caught when the last piece lands, so there is always a move here
+		boardColumn = solver.Search(game.board, limits).column;
 	}
 
-	if (cursorPos.x > windowWidth * .4f &&
-		cursorPos.x < windowWidth * .6f &&
-		cursorPos.y > windowHeight * .3f &&
-		cursorPos.y < windowHeight * .4f)
-	{
-		//play button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .3f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
+	return boardColumn;
+}
+
+//steps the game flow and does what the step reports
+void UpdateGame(ConnectFour::GameInput& input) noexcept
+{
+	if (game.phase == ConnectFour::GamePhase::CPUTurn && !input.escape)
+		input.cpuColumn = CPUMove();
 
-		renderTarget->DrawTextW(L"PLAY", 4, MainTextFormat.Get(), textArea, brush.Get());
+	//read after the search, so the piece starts falling from the top
+	game = ConnectFour::StepGame(game, input, GameClock(), gameTiming);
 
-		if (mouseClicked)
+	if (game.events & ConnectFour::EventPlayerMoved)
+	{
+		//start on the reply while the piece is still falling
+		if (!game.board.IsWinningMove(game.fallingColumn))
 		{
-			gameState = 1;
+			ConnectFour::Position next = game.board;
+			next.Play(game.fallingColumn);
+
+			if (!next.IsFull())
+				ponderer.Think(next);
 		}
 	}
-	else if (
-		cursorPos.x > windowWidth * .4f &&
-		cursorPos.x < windowWidth * .6f &&
-		cursorPos.y > windowHeight * .45f &&
-		cursorPos.y < windowHeight * .55f)
+
+	if (game.events & ConnectFour::EventCPUMoved)
 	{
-		//exit button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .45f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"EXIT", 4, MainTextFormat.Get(), textArea, brush.Get());
-
-		if (mouseClicked)
+		//guess the player's reply and search the answers to it until the player moves
+		if (!game.board.IsWinningMove(game.fallingColumn))
 		{
-			ExitProcess(EXIT_SUCCESS);
+			ConnectFour::Position next = game.board;
+			next.Play(game.fallingColumn);
+			ponderer.Ponder(next);
 		}
 	}
 
-	mouseClicked = false;
+	if (game.events & ConnectFour::EventGameLeft)
+		ponderer.Stop();
 
-	FATAL_ON_FAIL(renderTarget->EndDraw());
+	if (game.events & (ConnectFour::EventGameFinished | ConnectFour::EventGameLeft))
+		ArchiveGame(game.record);
+
+	if (game.events & ConnectFour::EventExit)
+		ExitProcess(EXIT_SUCCESS);
 }
 
-void DrawGame() noexcept
+D2D1_RECT_F D2DRect(const ConnectFour::SceneRect& rect) noexcept
 {
+	return
+	{
+		.left = rect.left,
+		.top = rect.top,
+		.right = rect.right,
+		.bottom = rect.bottom
+	};
+}
 
+void DrawMenu(const ConnectFour::GameInput& input) noexcept
+{
 	if (renderTarget == nullptr)
 	{
 		CreateAssets();
 	}
 
+	const ConnectFour::SceneLayout& layout = scene.Layout();
+
 	renderTarget->BeginDraw();
 	renderTarget->Clear();
 
-	FLOAT ScoreWidth = .2 * windowWidth;
+	renderTarget->DrawTextW(L"CONNECT FOUR", 12, TitleTextFormat.Get(), D2DRect(layout.title), PlayerBrush.Get());
 
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2 - ScoreWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-		renderTarget->DrawTextW(L"YOU", 3, MainTextFormat.Get(), textArea, PlayerBrush.Get());
-	}
+	//the button under the cursor is drawn in the board's color
+	renderTarget->DrawTextW(L"PLAY", 4, MainTextFormat.Get(), D2DRect(layout.playText),
+		input.button == ConnectFour::MenuButton::Play ? brush.Get() : GhostBrush.Get());
 
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2 - ScoreWidth,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-
-		std::wstring scoreText = std::to_wstring(playerScore);
-		renderTarget->DrawTextW(scoreText.c_str(), scoreText.length(), MainTextFormat.Get(), textArea, PlayerBrush.Get());
-	}
+	renderTarget->DrawTextW(L"EXIT", 4, MainTextFormat.Get(), D2DRect(layout.exitText),
+		input.button == ConnectFour::MenuButton::Exit ? brush.Get() : GhostBrush.Get());
 
+	renderTarget->DrawTextW(L"\u24B8 2023 badasahog. All Rights Reserved", 37, CopyrightTextFormat.Get(), D2DRect(layout.copyright), GhostBrush.Get());
 
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2 + ScoreWidth,
-			.top = 0,
-			.right = (FLOAT)windowWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-		renderTarget->DrawTextW(L"CPU", 3, MainTextFormat.Get(), textArea, CPUBrush.Get());
-	}
+	FATAL_ON_FAIL(renderTarget->EndDraw());
+}
 
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2 + ScoreWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-
-		std::wstring scoreText = std::to_wstring(CPUScore);
-		renderTarget->DrawTextW(scoreText.c_str(), scoreText.length(), MainTextFormat.Get(), textArea, CPUBrush.Get());
+ID2D1Brush* BrushFor(ConnectFour::SceneBrush sceneBrush) noexcept
+{
+	switch (sceneBrush)
+	{
+	case ConnectFour::SceneBrush::Player:
+		return PlayerBrush.Get();
+	case ConnectFour::SceneBrush::CPU:
+		return CPUBrush.Get();
+	case ConnectFour::SceneBrush::Ghost:
+		return GhostBrush.Get();
+	case ConnectFour::SceneBrush::PlayerWin:
+		return PlayerWinBrush.Get();
+	case ConnectFour::SceneBrush::CPUWin:
+		return CPUWinBrush.Get();
+	default:
+		return brush.Get();
 	}
+}
 
-	float boardMarginsHorizontal = (FLOAT)windowWidth * .1f;
-
-	float boardWidth = (FLOAT)windowWidth - boardMarginsHorizontal * 2;
-
-	float c4SquareSize = boardWidth / 7.f;
-
-	float boardMarginTop = (FLOAT)windowWidth * .25f;
+//plays the scene's draw list, which only repaints what changed since the last frame
+void DrawGame(const ConnectFour::GameInput& input) noexcept
+{
 
-	float boardHeight = c4SquareSize * 6;
+	if (renderTarget == nullptr)
+	{
+		CreateAssets();
+	}
 
+	const ConnectFour::SceneLayout& layout = scene.Layout();
 
-	D2D1_RECT_F boardRect =
-	{
-		.left = boardMarginsHorizontal,
-		.top = boardMarginTop,
-		.right = boardMarginsHorizontal + boardWidth,
-		.bottom = boardMarginTop + boardHeight
-	};
+	D2D1_RECT_F boardRect = D2DRect(layout.board);
 
 	if (!bGeometryIsValid)
 	{
@@ -591,30 +410,28 @@ void DrawGame() noexcept
 
 		FATAL_ON_FAIL(factory->CreateRectangleGeometry(boardRect, &boundingSquare));
 
-		ID2D1EllipseGeometry* cutoutCircle[6 * 7];
+		ID2D1EllipseGeometry* cutoutCircle[ConnectFour::CellCount];
 
-		for (int x = 0; x < 7; x++)
+		for (int x = 0; x < ConnectFour::Width; x++)
 		{
-			for (int y = 0; y < 6; y++)
+			for (int y = 0; y < ConnectFour::Height; y++)
 			{
+				ConnectFour::ScenePoint center = layout.CellCenter(x, y);
+
 				D2D1_ELLIPSE ellipse =
 				{
-					.point =
-					{
-						.x = boardRect.left + c4SquareSize * x + c4SquareSize / 2,
-						.y = boardRect.top + c4SquareSize * y + c4SquareSize / 2
-					},
-					.radiusX = (c4SquareSize / 2) * .8f,
-					.radiusY = (c4SquareSize / 2) * .8f
+					.point = { .x = center.x, .y = center.y },
+					.radiusX = layout.holeRadius,
+					.radiusY = layout.holeRadius
 				};
 				
-				FATAL_ON_FAIL(factory->CreateEllipseGeometry(ellipse, &cutoutCircle[x * 6 + y]));
+				FATAL_ON_FAIL(factory->CreateEllipseGeometry(ellipse, &cutoutCircle[x * ConnectFour::Height + y]));
 			}
 		}
 
 		ComPtr<ID2D1GeometryGroup> geometryGroup;
 
-		FATAL_ON_FAIL(factory->CreateGeometryGroup(D2D1_FILL_MODE_WINDING, (ID2D1Geometry**)&cutoutCircle[0], 6 * 7, &geometryGroup));
+		FATAL_ON_FAIL(factory->CreateGeometryGroup(D2D1_FILL_MODE_WINDING, (ID2D1Geometry**)&cutoutCircle[0], ConnectFour::CellCount, &geometryGroup));
 
 
 		FATAL_ON_FAIL(factory->CreatePathGeometry(&boardShape));
@@ -628,7 +445,7 @@ void DrawGame() noexcept
 
 		FATAL_ON_FAIL(GeometrySink->Close());
 
-		for (int i = 0; i < 6 * 7; i++)
+		for (int i = 0; i < ConnectFour::CellCount; i++)
 		{
 			cutoutCircle[i]->Release();
 		}
@@ -636,232 +453,161 @@ void DrawGame() noexcept
 		bGeometryIsValid = true;
 	}
 
+	const ConnectFour::DrawList& drawList = scene.Update(game, input.column);
 
-	//draw the pieces
-	for (int x = 0; x < 7; x++)
-	{
-		for (int y = 0; y < 6; y++)
-		{
-			if (boardState[x][y] != 0)
-			{
-				D2D1_RECT_F rect =
-				{
-					.left = boardMarginsHorizontal + c4SquareSize * x,
-					.top = boardMarginTop + c4SquareSize * y,
-					.right = boardMarginsHorizontal + c4SquareSize * (x + 1),
-					.bottom = boardMarginTop + c4SquareSize * (y + 1)
-				};
+	if (drawList.count == 0)
+		return;
 
-				if (hilightWinningPieces)
-				{
-					if (boardState[x][y] == 1)//blue
-						renderTarget->FillRectangle(rect, PlayerBrush.Get());
-					else if (boardState[x][y] == 2)//red
-						renderTarget->FillRectangle(rect, CPUBrush.Get());
-					else if (boardState[x][y] == 3)//hilighted blue
-						renderTarget->FillRectangle(rect, PlayerWinBrush.Get());
-					else if (boardState[x][y] == 4)//hilighted red
-						renderTarget->FillRectangle(rect, CPUWinBrush.Get());
-				}
-				else
-				{
-					if (boardState[x][y] == 1 || boardState[x][y] == 3)//blue
-						renderTarget->FillRectangle(rect, PlayerBrush.Get());
-					else if (boardState[x][y] == 2 || boardState[x][y] == 4)//red
-						renderTarget->FillRectangle(rect, CPUBrush.Get());
-				}
-			}
-		}
-	}
+	renderTarget->BeginDraw();
 
-	if (gameState == 1)
+	for (int i = 0; i < drawList.count; i++)
 	{
-		POINT cursorPos;
-		FATAL_ON_FALSE(GetCursorPos(&cursorPos));
-		FATAL_ON_FALSE(ScreenToClient(Window, &cursorPos));
+		const ConnectFour::DrawCommand& command = drawList.commands[i];
 
+		D2D1_RECT_F rect = D2DRect(command.rect);
 
-		if (cursorPos.x > boardRect.left && cursorPos.x < boardRect.right)
+		switch (command.op)
 		{
-			int boardColumn = (cursorPos.x - boardRect.left) / c4SquareSize;
-
-			D2D1_ELLIPSE playerPiece =
+		case ConnectFour::DrawOp::PushClip:
+			//regions are whole pixels, so the edges need no blending
+			renderTarget->PushAxisAlignedClip(rect, D2D1_ANTIALIAS_MODE_ALIASED);
+			break;
+		case ConnectFour::DrawOp::PopClip:
+			renderTarget->PopAxisAlignedClip();
+			break;
+		case ConnectFour::DrawOp::Clear:
+			renderTarget->Clear();
+			break;
+		case ConnectFour::DrawOp::FillRectangle:
+			renderTarget->FillRectangle(rect, BrushFor(command.brush));
+			break;
+		case ConnectFour::DrawOp::FillEllipse:
+		{
+			D2D1_ELLIPSE ellipse =
 			{
 				.point =
 				{
-					.x = boardMarginsHorizontal + c4SquareSize * boardColumn + c4SquareSize / 2,
-					.y = boardMarginTop - c4SquareSize + c4SquareSize / 2
+					.x = (rect.left + rect.right) / 2,
+					.y = (rect.top + rect.bottom) / 2
 				},
-				.radiusX = (c4SquareSize / 2) * .85f,
-				.radiusY = (c4SquareSize / 2) * .85f
+				.radiusX = (rect.right - rect.left) / 2,
+				.radiusY = (rect.bottom - rect.top) / 2
 			};
-			renderTarget->FillEllipse(playerPiece, PlayerBrush.Get());
-
-			if (mouseClicked)
-			{
-				for (int i = 0; i < 6; i++)
-				{
-					if (boardState[boardColumn][5 - i] == 0)
-					{
-
-						fallingPieceColor = 1;
-						fallingPiecePosY = boardMarginTop - c4SquareSize + c4SquareSize / 2;
-						fallingPieceX = boardColumn;
-						fallingPieceTargetY = 5 - i;
-						gameState = 3;
-						break;
-					}
-				}
-			}
+			renderTarget->FillEllipse(ellipse, BrushFor(command.brush));
+			break;
 		}
-	}
-	else if (gameState == 2)
-	{
-		char availableColumns[7] = { 0 };
-		int numAvailableMoves = 0;
-
-		for (int i = 0; i < 7; i++)
-		{
-			if (boardState[i][0] == 0)
-			{
-				availableColumns[numAvailableMoves] = i;
-				numAvailableMoves++;
-			}
+		case ConnectFour::DrawOp::FillBoard:
+			renderTarget->FillGeometry(boardShape.Get(), BrushFor(command.brush));
+			break;
+		case ConnectFour::DrawOp::Text:
+			renderTarget->DrawTextW(command.text, command.textLength, MainTextFormat.Get(), rect, BrushFor(command.brush));
+			break;
 		}
+	}
 
-		if (numAvailableMoves == 0)
-			gameState = 4;
-
-		int boardColumn = availableColumns[rand() % numAvailableMoves];
+	FATAL_ON_FAIL(renderTarget->EndDraw());
+}
 
-		for (int i = 0; i < 6; i++)
-		{
-			if (boardState[boardColumn][5 - i] == 0)
-			{
-				fallingPieceColor = 2;
-				fallingPiecePosY = boardMarginTop - c4SquareSize + c4SquareSize / 2;
-				fallingPieceX = boardColumn;
-				fallingPieceTargetY = 5 - i;
-				gameState = 3;
-				break;
-			}
-		}
-	}
-	else if (gameState == 3)
+//the frame the game state needs next, input asks for its own frames in WindowProc
+void ScheduleNextFrame() noexcept
+{
+	if (game.phase == ConnectFour::GamePhase::PieceFalling)
 	{
-		D2D1_ELLIPSE playerPiece =
-		{
-			.point =
-			{
-				.x = boardMarginsHorizontal + c4SquareSize * fallingPieceX + c4SquareSize / 2,
-				.y = fallingPiecePosY
-			},
-			.radiusX = (c4SquareSize / 2) * .85f,
-			.radiusY = (c4SquareSize / 2) * .85f
-		};
-
-		if (fallingPieceColor == 1)
-		{
-			renderTarget->FillEllipse(playerPiece, PlayerBrush.Get());
-		}
-		else
-		{
-			renderTarget->FillEllipse(playerPiece, CPUBrush.Get());
-		}
-
-		LARGE_INTEGER tickCountNow;
-		FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
+		frameScheduler.RequestAnimationFrame();
+		return;
+	}
 
-		if (TickCountPrevious.QuadPart != 0)
-		{
-			fallingPiecePosY += ((tickCountNow.QuadPart - TickCountPrevious.QuadPart) / (float)FallingPieceSpeed.QuadPart) * windowHeight;
-		}
+	std::chrono::nanoseconds nextChange = ConnectFour::NextGameChange(game, GameClock(), gameTiming);
 
-		TickCountPrevious.QuadPart = tickCountNow.QuadPart;
-		
+	if (nextChange != (std::chrono::nanoseconds::max)())
+		frameScheduler.RequestFrameAt(ConnectFour::FrameScheduler::TimePoint(std::chrono::duration_cast<ConnectFour::FrameScheduler::Duration>(nextChange)));
+}
 
-		if (fallingPiecePosY > (boardMarginTop + c4SquareSize * (fallingPieceTargetY + 1) - c4SquareSize / 2))
-		{
-			boardState[fallingPieceX][fallingPieceTargetY] = fallingPieceColor;
+//steps the game and draws what changed, WM_PAINT and the message loop both come here
+void RenderFrame() noexcept
+{
+	frameScheduler.BeginFrame();
 
-			if (CheckForWinner(fallingPieceX, fallingPieceTargetY))
-			{
-				gameState = 4;
+	ConnectFour::GameInput input = ReadInput();
 
-				CurrentTimerFinished.QuadPart = tickCountNow.QuadPart + GameFinishedTicks.QuadPart;
+	UpdateGame(input);
 
-				if (fallingPieceColor == 1)
-				{
-					playerScore++;
-				}
-				else
-				{
-					CPUScore++;
-				}
-			}
-			else
-			{
-				if (fallingPieceColor == 1)
-				{
-					gameState = 2;
-				}
-				else
-				{
-					gameState = 1;
-				}
-			}
+	if (game.phase == ConnectFour::GamePhase::Menu)
+	{
+		DrawMenu(input);
 
-			TickCountPrevious.QuadPart = 0;
-		}
+		//the menu draws over the whole window
+		scene.Invalidate();
 	}
-	else if (gameState == 4)
+	else
 	{
-		LARGE_INTEGER tickCountNow;
-		FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-
-		if(fmod((CurrentTimerFinished.QuadPart - tickCountNow.QuadPart) / (float)GameFinishedTicks.QuadPart, .15f) < .075f)
-			hilightWinningPieces = true;
-		else
-			hilightWinningPieces = false;
-
-		if (CurrentTimerFinished.QuadPart < tickCountNow.QuadPart)
-		{
-			hilightWinningPieces = false;
-			gameState = 1;
-			memset(boardState, 0, sizeof(boardState));
-		}
+		DrawGame(input);
 	}
 
-	//draw the board
+	ScheduleNextFrame();
+}
 
-	renderTarget->FillGeometry(boardShape.Get(), brush.Get());
+//how long the message loop may sleep, rounded up since waking early only means waiting again
+DWORD FrameWaitMilliseconds() noexcept
+{
+	ConnectFour::FrameScheduler::Duration wait = frameScheduler.TimeUntilFrame();
 
-	mouseClicked = false;
+	//a minimized window draws nothing until it is restored
+	if (IsIconic(Window) || wait == (ConnectFour::FrameScheduler::Duration::max)())
+		return INFINITE;
 
-	FATAL_ON_FAIL(renderTarget->EndDraw());
+	return (DWORD)std::chrono::ceil<std::chrono::milliseconds>(wait).count();
 }
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nCmdShow)
+//the data files live next to the executable, not in whatever the working directory is.
+//the loaders open narrow paths, so the path is asked for in the same ANSI code page
+[[nodiscard]]
+bool ExecutableDirectoryPath(const char* fileName, char (&path)[MAX_PATH]) noexcept
 {
-	LARGE_INTEGER ProcessorFrequency;
-	FATAL_ON_FALSE(QueryPerformanceFrequency(&ProcessorFrequency));
+	DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+
+	//MAX_PATH means the path was cut short
+	if (length == 0 || length == MAX_PATH)
+		return false;
+
+	const char* separator = strrchr(path, '\\');
+	size_t directoryLength = separator == nullptr ? 0 : (size_t)(separator - path) + 1;
+	size_t nameLength = strlen(fileName);
 
-	GameFinishedTicks.QuadPart = ProcessorFrequency.QuadPart * 1;
+	if (directoryLength + nameLength >= MAX_PATH)
+		return false;
+
+	memcpy(path + directoryLength, fileName, nameLength + 1);
+	return true;
+}
 
-	FallingPieceSpeed.QuadPart = ProcessorFrequency.QuadPart * .5;
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nCmdShow)
+{
+	char path[MAX_PATH];
 
+	//the book is optional, without it the CPU searches every move
+	if (ExecutableDirectoryPath("ConnectFour.book", path) && openingBook.Open(path))
 	{
-		LARGE_INTEGER tickCountNow;
-		FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-		srand(tickCountNow.LowPart);
+		solver.UseBook(&openingBook);
+		ponderer.UseBook(&openingBook);
 	}
 
+	//without a weights file the built in weights are used
+	if (ExecutableDirectoryPath("ConnectFour.eval", path))
+		(void)evalWeights.Load(path);
+
+	solver.UseEvaluation(&evalWeights);
+
+	//without an archive games are simply not recorded
+	if (ExecutableDirectoryPath("ConnectFour.games", path))
+		(void)gameArchive.Open(path);
+
 	SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 
-	UINT dpi = GetDpiForSystem();
+	windowDpi = GetDpiForSystem();
 
-	windowWidth = 6 * dpi;
-	windowHeight = 6 * dpi;
+	windowWidth = 6 * windowDpi;
+	windowHeight = 6 * windowDpi;
 
 	// Register the window class.
 	constexpr wchar_t CLASS_NAME[] = L"Window CLass";
@@ -921,25 +667,36 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 
 	MSG Message = { 0 };
 
-	while (Message.message != WM_QUIT)
+	//drain the queue, draw if a frame is due, then block until input arrives or the next
+	//frame is due. a static screen leaves the thread asleep
+	while (true)
 	{
-		if (PeekMessageW(&Message, nullptr, 0, 0, PM_REMOVE))
+		while (PeekMessageW(&Message, nullptr, 0, 0, PM_REMOVE))
 		{
+			if (Message.message == WM_QUIT)
+				return EXIT_SUCCESS;
+
 			FATAL_ON_FALSE(TranslateMessage(&Message));
 			DispatchMessageW(&Message);
 		}
-	}
 
-	return EXIT_SUCCESS;
+		if (frameScheduler.FrameDue() && !IsIconic(Window))
+		{
+			RenderFrame();
+			continue;
+		}
+
+		MsgWaitForMultipleObjects(0, nullptr, FALSE, FrameWaitMilliseconds(), QS_ALLINPUT);
+	}
 }
 
 void handleDpiChange() noexcept
 {
 	SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
-	UINT dpi = GetDpiForSystem();
+	windowDpi = GetDpiForSystem();
 
-	windowWidth = 6 * dpi;
-	windowHeight = 6 * dpi;
+	windowWidth = 6 * windowDpi;
+	windowHeight = 6 * windowDpi;
 
 	RECT windowRect =
 	{
@@ -985,11 +742,15 @@ LRESULT CALLBACK IdleProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 		handleDpiChange();
 		break;
 	case WM_PAINT:
-		Sleep(25);
+		//nothing is drawn while minimized
+		FATAL_ON_FALSE(ValidateRect(hwnd, nullptr));
 		break;
 	case WM_SIZE:
 		if (!IsIconic(hwnd))
+		{
 			FATAL_ON_FALSE(SetWindowLongPtrA(hwnd, GWLP_WNDPROC, (LONG_PTR)&WindowProc) != 0);
+			frameScheduler.Invalidate();
+		}
 		break;
 	case WM_DESTROY:
 		PostQuitMessage(0);
@@ -1010,17 +771,33 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 	case WM_LBUTTONUP:
 	case WM_LBUTTONDBLCLK:
 		mouseClicked = true;
+		frameScheduler.Invalidate();
+		break;
+	case WM_MOUSEMOVE:
+		//the menu highlights the button under the cursor and the board shows a piece over its column
+		if (!trackingMouse)
+		{
+			TRACKMOUSEEVENT track =
+			{
+				.cbSize = sizeof(TRACKMOUSEEVENT),
+				.dwFlags = TME_LEAVE,
+				.hwndTrack = hwnd
+			};
+
+			trackingMouse = TrackMouseEvent(&track) != FALSE;
+		}
+		frameScheduler.Invalidate();
+		break;
+	case WM_MOUSELEAVE:
+		trackingMouse = false;
+		frameScheduler.Invalidate();
 		break;
 	case WM_KEYDOWN:
 		if (wParam == VK_ESCAPE) {
-			gameState = 0;
-
-			memset(boardState, 0, sizeof(boardState));
-
-			hilightWinningPieces = false;
-			playerScore = 0;
-			CPUScore = 0;
+			//the next frame leaves the game
+			escapePressed = true;
 			mouseClicked = false;
+			frameScheduler.Invalidate();
 		}
 		break;
 	case WM_DPICHANGED:
@@ -1035,10 +812,12 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		CreateAssets();
 		[[fallthrough]];
 	case WM_PAINT:
-		if (gameState == 0)
-			DrawMenu();
-		else
-			DrawGame();
+		//the window was resized or uncovered, so nothing on it can be trusted
+		scene.Invalidate();
+		RenderFrame();
+
+		//everything is drawn through Direct2D, there is nothing left for a WM_PAINT to do
+		FATAL_ON_FALSE(ValidateRect(hwnd, nullptr));
 		break;
 	default:
 		return DefWindowProcW(hwnd, uMsg, wParam, lParam);
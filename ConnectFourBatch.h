@@ -0,0 +1,230 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CONNECTFOUR_BATCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CONNECTFOUR_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+//msvc compiles intrinsics for any instruction set without being asked
+#define CONNECTFOUR_TARGET(instructionSet)
+#endif
+
+#include "ConnectFourCore.h"
+
+//masks for many positions at once
+//
+//positions come in structure of arrays layout, current[i] and mask[i] being the two
+//bitboards of Position i, and every output is an array of the same length:
+//
+//  playable  the cells a stone can be dropped into
+//  threats   empty cells that would give the side to move four in a row
+//  wins      threats that are also playable, the immediately winning moves
+//
+//AVX-512 works on 8 positions per instruction and AVX2 on 4, whichever the CPU supports
+//is picked the first time EvaluateBatch() runs. anything else, and any tail shorter than
+//a vector, goes through the same bitboard code as Position
+
+namespace ConnectFour
+{
+	enum class BatchInstructionSet
+	{
+		Scalar,
+		AVX2,
+		AVX512
+	};
+
+	struct BatchMasks
+	{
+		Bitboard* playable;
+		Bitboard* threats;
+		Bitboard* wins;
+	};
+
+	namespace Detail
+	{
+		inline void EvaluateBatchScalar(const Bitboard* current, const Bitboard* mask, size_t count, const BatchMasks& out) noexcept
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				Bitboard playable = (mask[i] + BottomRow) & FullBoard;
+				Bitboard threats = WinningSpots(current[i], mask[i]);
+
+				out.playable[i] = playable;
+				out.threats[i] = threats;
+				out.wins[i] = threats & playable;
+			}
+		}
+
+#ifdef CONNECTFOUR_BATCH_X86
+		//the lines through a cell along one direction, same as the loop in WinningSpots()
+		template<int Shift>
+		CONNECTFOUR_TARGET("avx2")
+		inline __m256i LineSpotsAVX2(__m256i stones) noexcept
+		{
+			__m256i up1 = _mm256_slli_epi64(stones, Shift);
+			__m256i down1 = _mm256_srli_epi64(stones, Shift);
+
+			__m256i pair = _mm256_and_si256(up1, _mm256_slli_epi64(stones, 2 * Shift));
+			__m256i spots = _mm256_and_si256(pair, _mm256_or_si256(_mm256_slli_epi64(stones, 3 * Shift), down1));
+
+			pair = _mm256_and_si256(down1, _mm256_srli_epi64(stones, 2 * Shift));
+			return _mm256_or_si256(spots, _mm256_and_si256(pair, _mm256_or_si256(_mm256_srli_epi64(stones, 3 * Shift), up1)));
+		}
+
+		CONNECTFOUR_TARGET("avx2")
+		inline void EvaluateBatchAVX2(const Bitboard* current, const Bitboard* mask, size_t count, const BatchMasks& out) noexcept
+		{
+			const __m256i full = _mm256_set1_epi64x((long long)FullBoard);
+			const __m256i bottom = _mm256_set1_epi64x((long long)BottomRow);
+
+			size_t i = 0;
+
+			for (; i + 4 <= count; i += 4)
+			{
+				__m256i stones = _mm256_loadu_si256((const __m256i*)(current + i));
+				__m256i occupied = _mm256_loadu_si256((const __m256i*)(mask + i));
+
+				__m256i spots = _mm256_and_si256(_mm256_and_si256(
+					_mm256_slli_epi64(stones, 1), _mm256_slli_epi64(stones, 2)), _mm256_slli_epi64(stones, 3));
+
+				spots = _mm256_or_si256(spots, LineSpotsAVX2<DirectionHorizontal>(stones));
+				spots = _mm256_or_si256(spots, LineSpotsAVX2<DirectionDiagonalUp>(stones));
+				spots = _mm256_or_si256(spots, LineSpotsAVX2<DirectionDiagonalDown>(stones));
+
+				__m256i threats = _mm256_andnot_si256(occupied, _mm256_and_si256(spots, full));
+				__m256i playable = _mm256_and_si256(_mm256_add_epi64(occupied, bottom), full);
+
+				_mm256_storeu_si256((__m256i*)(out.playable + i), playable);
+				_mm256_storeu_si256((__m256i*)(out.threats + i), threats);
+				_mm256_storeu_si256((__m256i*)(out.wins + i), _mm256_and_si256(threats, playable));
+			}
+
+			EvaluateBatchScalar(current + i, mask + i, count - i, { out.playable + i, out.threats + i, out.wins + i });
+		}
+
+		template<int Shift>
+		CONNECTFOUR_TARGET("avx512f")
+		inline __m512i LineSpotsAVX512(__m512i stones) noexcept
+		{
+			__m512i up1 = _mm512_slli_epi64(stones, Shift);
+			__m512i down1 = _mm512_srli_epi64(stones, Shift);
+
+			__m512i pair = _mm512_and_si512(up1, _mm512_slli_epi64(stones, 2 * Shift));
+			__m512i spots = _mm512_and_si512(pair, _mm512_or_si512(_mm512_slli_epi64(stones, 3 * Shift), down1));
+
+			pair = _mm512_and_si512(down1, _mm512_srli_epi64(stones, 2 * Shift));
+			return _mm512_or_si512(spots, _mm512_and_si512(pair, _mm512_or_si512(_mm512_srli_epi64(stones, 3 * Shift), up1)));
+		}
+
+		CONNECTFOUR_TARGET("avx512f")
+		inline void EvaluateBatchAVX512(const Bitboard* current, const Bitboard* mask, size_t count, const BatchMasks& out) noexcept
+		{
+			const __m512i full = _mm512_set1_epi64((long long)FullBoard);
+			const __m512i bottom = _mm512_set1_epi64((long long)BottomRow);
+
+			size_t i = 0;
+
+			for (; i + 8 <= count; i += 8)
+			{
+				__m512i stones = _mm512_loadu_si512(current + i);
+				__m512i occupied = _mm512_loadu_si512(mask + i);
+
+				__m512i spots = _mm512_and_si512(_mm512_and_si512(
+					_mm512_slli_epi64(stones, 1), _mm512_slli_epi64(stones, 2)), _mm512_slli_epi64(stones, 3));
+
+				spots = _mm512_or_si512(spots, LineSpotsAVX512<DirectionHorizontal>(stones));
+				spots = _mm512_or_si512(spots, LineSpotsAVX512<DirectionDiagonalUp>(stones));
+				spots = _mm512_or_si512(spots, LineSpotsAVX512<DirectionDiagonalDown>(stones));
+
+				__m512i threats = _mm512_andnot_si512(occupied, _mm512_and_si512(spots, full));
+				__m512i playable = _mm512_and_si512(_mm512_add_epi64(occupied, bottom), full);
+
+				_mm512_storeu_si512(out.playable + i, playable);
+				_mm512_storeu_si512(out.threats + i, threats);
+				_mm512_storeu_si512(out.wins + i, _mm512_and_si512(threats, playable));
+			}
+
+			EvaluateBatchScalar(current + i, mask + i, count - i, { out.playable + i, out.threats + i, out.wins + i });
+		}
+#endif
+	}
+
+	//the widest instruction set both the CPU and the operating system support
+	[[nodiscard]]
+	inline BatchInstructionSet DetectBatchInstructionSet() noexcept
+	{
+#if !defined(CONNECTFOUR_BATCH_X86)
+		return BatchInstructionSet::Scalar;
+#elif defined(_MSC_VER)
+		int info[4];
+
+		__cpuid(info, 1);
+
+		//the os has to save the vector registers on a context switch
+		if ((info[2] & (1 << 27)) == 0)
+			return BatchInstructionSet::Scalar;
+
+		unsigned long long enabled = _xgetbv(0);
+
+		__cpuidex(info, 7, 0);
+
+		if ((info[1] & (1 << 16)) && (enabled & 0xE6) == 0xE6)
+			return BatchInstructionSet::AVX512;
+
+		if ((info[1] & (1 << 5)) && (enabled & 0x6) == 0x6)
+			return BatchInstructionSet::AVX2;
+
+		return BatchInstructionSet::Scalar;
+#else
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx512f"))
+			return BatchInstructionSet::AVX512;
+
+		if (__builtin_cpu_supports("avx2"))
+			return BatchInstructionSet::AVX2;
+
+		return BatchInstructionSet::Scalar;
+#endif
+	}
+
+	//instructionSet has to be one DetectBatchInstructionSet() allows, or Scalar
+	inline void EvaluateBatch(const Bitboard* current, const Bitboard* mask, size_t count, const BatchMasks& out, BatchInstructionSet instructionSet) noexcept
+	{
+		switch (instructionSet)
+		{
+#ifdef CONNECTFOUR_BATCH_X86
+		case BatchInstructionSet::AVX512:
+			Detail::EvaluateBatchAVX512(current, mask, count, out);
+			break;
+		case BatchInstructionSet::AVX2:
+			Detail::EvaluateBatchAVX2(current, mask, count, out);
+			break;
+#endif
+		default:
+			Detail::EvaluateBatchScalar(current, mask, count, out);
+			break;
+		}
+	}
+
+	inline void EvaluateBatch(const Bitboard* current, const Bitboard* mask, size_t count, const BatchMasks& out) noexcept
+	{
+		static const BatchInstructionSet detected = DetectBatchInstructionSet();
+		EvaluateBatch(current, mask, count, out, detected);
+	}
+}
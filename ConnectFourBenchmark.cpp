@@ -0,0 +1,1025 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//benchmarks for the rules core and the engine hot paths
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourBenchmark.cpp -o ConnectFourBenchmark
+//usage: ConnectFourBenchmark [-positions N] [-games N] [-hash MB] [-seed N] [-o FILE]
+//
+//measures, single threaded:
+//  win detection    the game's original array based CheckForWinner against the bitboard test
+//                   and against the line tables
+//  move generation  possible and non losing moves, and make/unmake of a move
+//  evaluation       incremental accumulator update and Evaluate(), and depth limited search
+//                   nodes per second with and without it
+//  batch            playable, threat and winning move masks per position, EvaluateBatch() on
+//                   every instruction set the CPU has against the original check per column
+//  solve            time and nodes to solve begin, middle and end game sets, easy and hard,
+//                   with null windows, with a full window and weakly (win, draw or loss),
+//                   and the nodes the move ordering saves over plain center first order
+//  table probe      transposition table probe latency, for a cache sized and a full sized table
+//  game flow        frames per second of the game's menu, moves and animations run headless
+//                   on a simulated clock, with random clicks and random CPU moves
+//
+//and on one thread and on every thread:
+//  mcts             playouts per second from the empty board
+//
+//everything is written as one JSON object, to stdout unless -o is given. the same seed
+//gives the same positions, so results from different versions can be compared directly
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourSolver.h"
+#include "ConnectFourBatch.h"
+#include "ConnectFourMCTS.h"
+#include "ConnectFourGameFlow.h"
+
+using namespace ConnectFour;
+
+//keeps the optimizer from dropping work whose result is never used
+static volatile uint64_t sink;
+
+//the win test the game used before the bitboard core, copied as it was to serve as the
+//baseline. x is the column, y the row counted from the top, and a win marks the winning
+//pieces with type + 2
+namespace Legacy
+{
+	using Board = char[7][6];
+
+	[[nodiscard]]
+	static constexpr int Min(int a, int b) noexcept
+	{
+		return a < b ? a : b;
+	}
+
+	[[nodiscard]]
+	static bool CheckForWinner(Board& boardState, int lastMoveX, int lastMoveY) noexcept
+	{
+		char objectiveType = boardState[lastMoveX][lastMoveY];
+
+		//theoretical maximum of 20 piece win
+
+		int winningPieces[20][2];
+		int winningPieceCount = 0;
+
+		bool winDetected = false;
+
+
+		//vertical:
+		{
+			if (lastMoveY < 3)//make sure we're not checking out of bounds
+			{
+				if (boardState[lastMoveX][lastMoveY + 1] == objectiveType &&
+					boardState[lastMoveX][lastMoveY + 2] == objectiveType &&
+					boardState[lastMoveX][lastMoveY + 3] == objectiveType)
+				{
+					winningPieces[winningPieceCount][0] = lastMoveX;
+					winningPieces[winningPieceCount][1] = lastMoveY + 1;
+					winningPieceCount++;
+
+					winningPieces[winningPieceCount][0] = lastMoveX;
+					winningPieces[winningPieceCount][1] = lastMoveY + 2;
+					winningPieceCount++;
+
+					winningPieces[winningPieceCount][0] = lastMoveX;
+					winningPieces[winningPieceCount][1] = lastMoveY + 3;
+					winningPieceCount++;
+
+					winDetected = true;
+				}
+			}
+		}
+
+		//horizontal:
+		{
+			int winningPiecesBookmark = winningPieceCount;
+			int sequentialPieces = 0;
+
+			//left
+			for (int i = 1; i < lastMoveX + 1; i++)
+			{
+				if (boardState[lastMoveX - i][lastMoveY] == objectiveType)
+				{
+					winningPieces[winningPieceCount][0] = lastMoveX - i;
+					winningPieces[winningPieceCount][1] = lastMoveY;
+
+					winningPieceCount++;
+					sequentialPieces++;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			//right
+			for (int i = 1; i < 6 - lastMoveX + 1; i++)
+			{
+				if (boardState[lastMoveX + i][lastMoveY] == objectiveType)
+				{
+					winningPieces[winningPieceCount][0] = lastMoveX + i;
+					winningPieces[winningPieceCount][1] = lastMoveY;
+
+					winningPieceCount++;
+					sequentialPieces++;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			if (sequentialPieces >= 3)
+			{
+				winDetected = true;
+			}
+			else
+			{
+				winningPieceCount = winningPiecesBookmark;
+			}
+		}
+
+		// "\"
+		{
+			int winningPiecesBookmark = winningPieceCount;
+			int sequentialPieces = 0;
+
+			{
+				//upward scan
+				int scanLength = Min(lastMoveX, lastMoveY);
+
+				for (int i = 0; i < scanLength; i++)
+				{
+					if (boardState[lastMoveX - (i + 1)][lastMoveY - (i + 1)] == objectiveType)
+					{
+						winningPieces[winningPieceCount][0] = lastMoveX - (i + 1);
+						winningPieces[winningPieceCount][1] = lastMoveY - (i + 1);
+
+						winningPieceCount++;
+						sequentialPieces++;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+			{
+				//downward scan
+				int scanLength = Min(6 - lastMoveX, 5 - lastMoveY);
+
+				for (int i = 0; i < scanLength; i++)
+				{
+					if (boardState[lastMoveX + (i + 1)][lastMoveY + (i + 1)] == objectiveType)
+					{
+						winningPieces[winningPieceCount][0] = lastMoveX + (i + 1);
+						winningPieces[winningPieceCount][1] = lastMoveY + (i + 1);
+
+						winningPieceCount++;
+						sequentialPieces++;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+			if (sequentialPieces >= 3)
+			{
+				winDetected = true;
+			}
+			else
+			{
+				winningPieceCount = winningPiecesBookmark;
+			}
+		}
+
+		// "/"
+		{
+			int winningPiecesBookmark = winningPieceCount;
+			int sequentialPieces = 0;
+
+			{
+				//upward scan
+				int scanLength = Min(6 - lastMoveX, lastMoveY);
+
+				for (int i = 0; i < scanLength; i++)
+				{
+					if (boardState[lastMoveX + (i + 1)][lastMoveY - (i + 1)] == objectiveType)
+					{
+						winningPieces[winningPieceCount][0] = lastMoveX + (i + 1);
+						winningPieces[winningPieceCount][1] = lastMoveY - (i + 1);
+
+						winningPieceCount++;
+						sequentialPieces++;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+			{
+				//downward scan
+				int scanLength = Min(lastMoveX, 5 - lastMoveY);
+
+				for (int i = 0; i < scanLength; i++)
+				{
+					if (boardState[lastMoveX - (i + 1)][lastMoveY + (i + 1)] == objectiveType)
+					{
+						winningPieces[winningPieceCount][0] = lastMoveX - (i + 1);
+						winningPieces[winningPieceCount][1] = lastMoveY + (i + 1);
+
+						winningPieceCount++;
+						sequentialPieces++;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+			if (sequentialPieces >= 3)
+			{
+				winDetected = true;
+			}
+			else
+			{
+				winningPieceCount = winningPiecesBookmark;
+			}
+		}
+
+		if (winDetected)
+		{
+			for (int i = 0; i < winningPieceCount; i++)
+			{
+				boardState[winningPieces[i][0]][winningPieces[i][1]] = objectiveType + 2;
+			}
+
+			boardState[lastMoveX][lastMoveY] = objectiveType + 2;
+
+			return true;
+		}
+
+		return false;
+	}
+}
+
+//random legal moves until the game ends, the last move wins unless the board is full
+[[nodiscard]]
+static std::vector<int> RandomGame(std::mt19937_64& rng)
+{
+	std::vector<int> moves;
+	Position position;
+
+	while (!position.IsFull())
+	{
+		int column;
+		do
+		{
+			column = (int)(rng() % Width);
+		} while (!position.CanPlay(column));
+
+		moves.push_back(column);
+
+		if (position.IsWinningMove(column))
+			break;
+
+		position.Play(column);
+	}
+
+	return moves;
+}
+
+//hard positions come from play that never hands the opponent a win, easy ones from any
+//legal move, which tends to leave one side far ahead
+[[nodiscard]]
+static bool RandomPosition(std::mt19937_64& rng, int stones, bool hard, Position& position) noexcept
+{
+	position = {};
+
+	while (position.MoveCount() < stones)
+	{
+		if (position.CanWinNext())
+			return false;
+
+		Bitboard moves = hard ? position.PossibleNonLosingMoves() : position.PossibleMoves();
+
+		if (moves == 0)
+			return false;
+
+		int column;
+		do
+		{
+			column = (int)(rng() % Width);
+		} while ((moves & ColumnMask(column)) == 0);
+
+		position.Play(column);
+	}
+
+	return !position.CanWinNext();
+}
+
+[[nodiscard]]
+static double Seconds(std::chrono::steady_clock::time_point start) noexcept
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void WinDetection(FILE* out, const std::vector<std::vector<int>>& games)
+{
+	//every move of every game is placed and tested, repeated until the timing is stable
+	constexpr int Repeats = 20;
+
+	uint64_t moves = 0;
+	uint64_t legacyWins = 0;
+	uint64_t bitboardWins = 0;
+	uint64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const std::vector<int>& game : games)
+		{
+			Legacy::Board board = {};
+			int heights[7] = {};
+
+			for (int i = 0; i < (int)game.size(); i++)
+			{
+				int x = game[i];
+				int y = 5 - heights[x]++;
+
+				board[x][y] = (char)(i % 2 + 1);
+
+				if (Legacy::CheckForWinner(board, x, y))
+				{
+					legacyWins++;
+					checksum += board[x][y];
+				}
+			}
+
+			moves += game.size();
+		}
+	}
+
+	double legacySeconds = Seconds(start);
+
+	start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const std::vector<int>& game : games)
+		{
+			Position position;
+
+			for (int column : game)
+			{
+				if (position.IsWinningMove(column))
+				{
+					bitboardWins++;
+					checksum += WinningCells(position.CurrentStones() | (position.PossibleMoves() & ColumnMask(column)));
+				}
+
+				position.Play(column);
+			}
+		}
+	}
+
+	double bitboardSeconds = Seconds(start);
+
+	//the lines through the landing cell, looked up in the line tables
+	uint64_t tableWins = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const std::vector<int>& game : games)
+		{
+			Position position;
+
+			for (int column : game)
+			{
+				int cell = CellIndex(column, position.ColumnHeight(column));
+				Bitboard cells = WinningLinesThrough(position.CurrentStones() | CellBit(column, position.ColumnHeight(column)), cell);
+
+				if (cells)
+				{
+					tableWins++;
+					checksum += cells;
+				}
+
+				position.Play(column);
+			}
+		}
+	}
+
+	double tableSeconds = Seconds(start);
+	sink = checksum;
+
+	fprintf(out, "\t\"win_detection\": {\n");
+	fprintf(out, "\t\t\"moves\": %llu,\n", (unsigned long long)moves);
+	fprintf(out, "\t\t\"results_match\": %s,\n", legacyWins == bitboardWins && legacyWins == tableWins ? "true" : "false");
+	fprintf(out, "\t\t\"legacy_ns_per_move\": %.3f,\n", legacySeconds * 1e9 / moves);
+	fprintf(out, "\t\t\"bitboard_ns_per_move\": %.3f,\n", bitboardSeconds * 1e9 / moves);
+	fprintf(out, "\t\t\"line_table_ns_per_move\": %.3f,\n", tableSeconds * 1e9 / moves);
+	fprintf(out, "\t\t\"speedup\": %.2f\n", legacySeconds / bitboardSeconds);
+	fprintf(out, "\t},\n");
+}
+
+static void MoveGeneration(FILE* out, const std::vector<Position>& positions)
+{
+	constexpr int Repeats = 2000;
+
+	uint64_t operations = (uint64_t)positions.size() * Repeats;
+	uint64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const Position& position : positions)
+			checksum += position.PossibleMoves();
+	}
+
+	double possibleSeconds = Seconds(start);
+
+	start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const Position& position : positions)
+			checksum += position.PossibleNonLosingMoves();
+	}
+
+	double nonLosingSeconds = Seconds(start);
+
+	//every playable column of every position, played and taken back
+	uint64_t makeUnmakeCount = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (Position position : positions)
+		{
+			Bitboard moves = position.PossibleMoves();
+
+			while (moves)
+			{
+				Bitboard move = moves & (0 - moves);
+				moves ^= move;
+
+				position.Play(move);
+				checksum += position.Key();
+				position.Undo(move);
+
+				makeUnmakeCount++;
+			}
+		}
+	}
+
+	double makeUnmakeSeconds = Seconds(start);
+	sink = checksum;
+
+	fprintf(out, "\t\"move_generation\": {\n");
+	fprintf(out, "\t\t\"positions\": %zu,\n", positions.size());
+	fprintf(out, "\t\t\"possible_moves_ns\": %.3f,\n", possibleSeconds * 1e9 / operations);
+	fprintf(out, "\t\t\"non_losing_moves_ns\": %.3f,\n", nonLosingSeconds * 1e9 / operations);
+	fprintf(out, "\t\t\"make_unmake_ns\": %.3f,\n", makeUnmakeSeconds * 1e9 / makeUnmakeCount);
+	fprintf(out, "\t\t\"make_unmake_per_second\": %.0f\n", makeUnmakeCount / makeUnmakeSeconds);
+	fprintf(out, "\t},\n");
+}
+
+static void BatchEvaluation(FILE* out, const std::vector<Position>& positions)
+{
+	constexpr int Repeats = 200;
+
+	size_t count = positions.size();
+	uint64_t operations = (uint64_t)count * Repeats;
+
+	std::vector<Bitboard> current(count);
+	std::vector<Bitboard> mask(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		current[i] = positions[i].CurrentStones();
+		mask[i] = positions[i].Occupied();
+	}
+
+	std::vector<Bitboard> expected[3];
+	for (std::vector<Bitboard>& masks : expected)
+		masks.resize(count);
+
+	EvaluateBatch(current.data(), mask.data(), count, { expected[0].data(), expected[1].data(), expected[2].data() }, BatchInstructionSet::Scalar);
+
+	//the same winning moves the way the game used to find them, one column at a time
+	std::vector<Legacy::Board> boards(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		memset(boards[i], 0, sizeof(Legacy::Board));
+
+		for (int x = 0; x < Width; x++)
+		{
+			for (int row = 0; row < Height; row++)
+			{
+				Bitboard cell = CellBit(x, row);
+
+				if (mask[i] & cell)
+					boards[i][x][Height - 1 - row] = current[i] & cell ? 1 : 2;
+			}
+		}
+	}
+
+	bool resultsMatch = true;
+	uint64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats / 20; repeat++)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			Bitboard wins = 0;
+
+			for (int x = 0; x < Width; x++)
+			{
+				int height = positions[i].ColumnHeight(x);
+
+				if (height == Height)
+					continue;
+
+				Legacy::Board board;
+				memcpy(board, boards[i], sizeof(board));
+
+				int y = Height - 1 - height;
+				board[x][y] = 1;
+
+				if (Legacy::CheckForWinner(board, x, y))
+					wins |= CellBit(x, height);
+			}
+
+			if (repeat == 0 && wins != expected[2][i])
+				resultsMatch = false;
+
+			checksum += wins;
+		}
+	}
+
+	double legacyNanoseconds = Seconds(start) * 1e9 / (operations / 20);
+
+	fprintf(out, "\t\"batch\": {\n");
+	fprintf(out, "\t\t\"positions\": %zu,\n", count);
+	fprintf(out, "\t\t\"legacy_ns_per_position\": %.3f,\n", legacyNanoseconds);
+
+	std::vector<Bitboard> masks[3];
+	for (std::vector<Bitboard>& output : masks)
+		output.resize(count);
+
+	const struct
+	{
+		BatchInstructionSet instructionSet;
+		const char* name;
+	} instructionSets[] =
+	{
+		{ BatchInstructionSet::Scalar, "scalar" },
+		{ BatchInstructionSet::AVX2, "avx2" },
+		{ BatchInstructionSet::AVX512, "avx512" }
+	};
+
+	BatchInstructionSet detected = DetectBatchInstructionSet();
+
+	for (const auto& instructionSet : instructionSets)
+	{
+		if (instructionSet.instructionSet > detected)
+			break;
+
+		start = std::chrono::steady_clock::now();
+
+		for (int repeat = 0; repeat < Repeats; repeat++)
+		{
+			EvaluateBatch(current.data(), mask.data(), count, { masks[0].data(), masks[1].data(), masks[2].data() }, instructionSet.instructionSet);
+			checksum += masks[2][repeat % count];
+		}
+
+		double nanoseconds = Seconds(start) * 1e9 / operations;
+
+		for (int i = 0; i < 3; i++)
+			resultsMatch = resultsMatch && masks[i] == expected[i];
+
+		fprintf(out, "\t\t\"%s_ns_per_position\": %.3f,\n", instructionSet.name, nanoseconds);
+		fprintf(out, "\t\t\"%s_speedup_over_legacy\": %.1f,\n", instructionSet.name, legacyNanoseconds / nanoseconds);
+	}
+
+	sink = checksum;
+
+	fprintf(out, "\t\t\"results_match\": %s\n", resultsMatch ? "true" : "false");
+	fprintf(out, "\t},\n");
+}
+
+static void Evaluation(FILE* out, const std::vector<Position>& positions, TranspositionTable& table)
+{
+	constexpr int Repeats = 200;
+	constexpr int SearchDepth = 8;
+	constexpr size_t SearchPositions = 200;
+
+	static const EvalWeights weights = EvalWeights::Default();
+
+	Evaluator evaluator;
+	evaluator.UseWeights(&weights);
+
+	uint64_t updates = 0;
+	int64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (const Position& position : positions)
+		{
+			Bitboard moves = position.PossibleMoves();
+			int side = position.MoveCount() & 1;
+
+			while (moves)
+			{
+				Bitboard move = moves & (0 - moves);
+				moves ^= move;
+
+				evaluator.Play(move, side);
+				evaluator.Undo(move, side);
+				updates++;
+			}
+		}
+	}
+
+	double updateSeconds = Seconds(start);
+
+	std::vector<Evaluator> refreshed(positions.size());
+
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		refreshed[i].UseWeights(&weights);
+		refreshed[i].Refresh(positions[i]);
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		for (size_t i = 0; i < positions.size(); i++)
+			checksum += refreshed[i].Evaluate(positions[i].MoveCount() & 1);
+	}
+
+	double evaluateSeconds = Seconds(start);
+	sink = (uint64_t)checksum;
+
+	fprintf(out, "\t\"evaluation\": {\n");
+	fprintf(out, "\t\t\"play_undo_ns\": %.3f,\n", updateSeconds * 1e9 / updates);
+	fprintf(out, "\t\t\"evaluate_ns\": %.3f,\n", evaluateSeconds * 1e9 / ((double)positions.size() * Repeats));
+
+	//the same positions searched to the same depth, horizon scored as a draw and by the evaluation
+	for (int evaluate = 0; evaluate < 2; evaluate++)
+	{
+		table.Clear();
+
+		Solver solver(table);
+		solver.UseEvaluation(evaluate ? &weights : nullptr);
+
+		start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < positions.size() && i < SearchPositions * 50; i += 50)
+			checksum += solver.Search(positions[i], { .maxDepth = SearchDepth }).column;
+
+		double seconds = Seconds(start);
+		sink = (uint64_t)checksum;
+
+		const char* prefix = evaluate ? "evaluated_" : "";
+
+		fprintf(out, "\t\t\"%sdepth_%d_nodes\": %llu,\n", prefix, SearchDepth, (unsigned long long)solver.NodeCount());
+		fprintf(out, "\t\t\"%sdepth_%d_mnodes_per_second\": %.3f%s\n", prefix, SearchDepth, solver.NodeCount() / seconds / 1e6, evaluate ? "" : ",");
+	}
+
+	fprintf(out, "\t},\n");
+}
+
+static void SolveSets(FILE* out, TranspositionTable& table, std::mt19937_64& rng, int positionCount)
+{
+	struct SolveSet
+	{
+		const char* name;
+		int stones;
+		bool hard;
+	};
+
+	//an exact solve from much earlier than 12 stones takes seconds per position
+	constexpr SolveSet sets[] =
+	{
+		{ "begin_easy", 12, false },
+		{ "begin_hard", 12, true },
+		{ "middle_easy", 20, false },
+		{ "middle_hard", 20, true },
+		{ "end_easy", 28, false },
+		{ "end_hard", 28, true }
+	};
+
+	fprintf(out, "\t\"solve\": {\n");
+
+	for (const SolveSet& set : sets)
+	{
+		std::vector<Position> positions;
+
+		while ((int)positions.size() < positionCount)
+		{
+			Position position;
+			if (RandomPosition(rng, set.stones, set.hard, position))
+				positions.push_back(position);
+		}
+
+		fprintf(out, "\t\t\"%s\": {\n", set.name);
+		fprintf(out, "\t\t\t\"stones\": %d,\n", set.stones);
+		fprintf(out, "\t\t\t\"positions\": %d,\n", positionCount);
+
+		//every mode starts from an empty table, so its results do not depend on what ran before
+		struct SolveMode
+		{
+			const char* prefix;
+			int (Solver::*solve)(const Position&) noexcept;
+			MoveOrdering ordering;
+		};
+
+		//center_first_ is the same solve with moves only ordered middle out, what the move
+		//ordering saves is its nodes over the first mode's
+		constexpr SolveMode modes[] =
+		{
+			{ "", &Solver::Solve, MoveOrdering::Full },
+			{ "center_first_", &Solver::Solve, MoveOrdering::CenterFirst },
+			{ "full_window_", &Solver::SolveFullWindow, MoveOrdering::Full },
+			{ "weak_", &Solver::SolveWeak, MoveOrdering::Full }
+		};
+
+		uint64_t nodes[std::size(modes)] = {};
+
+		for (const SolveMode& mode : modes)
+		{
+			table.Clear();
+
+			Solver solver(table);
+			solver.UseMoveOrdering(mode.ordering);
+			int checksum = 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (const Position& position : positions)
+				checksum += (solver.*mode.solve)(position);
+
+			double seconds = Seconds(start);
+			sink = checksum;
+
+			fprintf(out, "\t\t\t\"%sscore_sum\": %d,\n", mode.prefix, checksum);
+			fprintf(out, "\t\t\t\"%smean_us\": %.3f,\n", mode.prefix, seconds * 1e6 / positionCount);
+			fprintf(out, "\t\t\t\"%snodes\": %llu,\n", mode.prefix, (unsigned long long)solver.NodeCount());
+			fprintf(out, "\t\t\t\"%smnodes_per_second\": %.3f,\n", mode.prefix, solver.NodeCount() / seconds / 1e6);
+
+			nodes[&mode - modes] = solver.NodeCount();
+		}
+
+		fprintf(out, "\t\t\t\"ordering_node_reduction\": %.2f\n", (double)nodes[1] / (nodes[0] ? nodes[0] : 1));
+
+		fprintf(out, "\t\t}%s\n", &set == &sets[std::size(sets) - 1] ? "" : ",");
+	}
+
+	fprintf(out, "\t},\n");
+}
+
+//fills half the table with random keys, then probes stored and missing keys alternately
+static void TableProbe(FILE* out, const char* name, TranspositionTable& table, std::mt19937_64& rng, bool last)
+{
+	constexpr uint64_t KeyMask = (Bitboard(1) << (Width * (Height + 1))) - 1;
+	constexpr int Probes = 1 << 22;
+
+	table.Clear();
+	TableStats stats = {};
+
+	//at half full a bucket almost never overflows, so nearly every stored key can be found
+	std::vector<Bitboard> stored(table.SizeBytes() / sizeof(uint64_t) / 2);
+
+	for (Bitboard& key : stored)
+	{
+		key = rng() & KeyMask;
+		table.Store(key, 0, Bound::Exact, 0, (int)(rng() % CellCount), stats);
+	}
+
+	std::vector<Bitboard> keys(Probes);
+
+	for (int i = 0; i < Probes; i++)
+		keys[i] = i % 2 ? rng() & KeyMask : stored[rng() % stored.size()];
+
+	stats = {};
+	uint64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (Bitboard key : keys)
+	{
+		TableEntry entry;
+		if (table.Probe(key, entry, stats))
+			checksum += entry.depth;
+	}
+
+	double seconds = Seconds(start);
+	sink = checksum;
+
+	fprintf(out, "\t\t\"%s\": {\n", name);
+	fprintf(out, "\t\t\t\"size_bytes\": %zu,\n", table.SizeBytes());
+	fprintf(out, "\t\t\t\"huge_pages\": %s,\n", table.UsesHugePages() ? "true" : "false");
+	fprintf(out, "\t\t\t\"probes\": %llu,\n", (unsigned long long)stats.probes);
+	fprintf(out, "\t\t\t\"hit_rate\": %.4f,\n", (double)stats.hits / stats.probes);
+	fprintf(out, "\t\t\t\"ns_per_probe\": %.3f\n", seconds * 1e9 / stats.probes);
+	fprintf(out, "\t\t}%s\n", last ? "" : ",");
+}
+
+static void MCTSPlayouts(FILE* out)
+{
+	constexpr uint64_t Playouts = 1 << 20;
+
+	int threadCounts[] = { 1, (int)std::thread::hardware_concurrency() };
+
+	fprintf(out, "\t\"mcts\": {\n");
+
+	for (int i = 0; i < 2; i++)
+	{
+		MCTS mcts(1, threadCounts[i]);
+		MCTSResult result = mcts.Search(Position(), { .playouts = Playouts });
+
+		fprintf(out, "\t\t\"%s\": {\n", i == 0 ? "single_thread" : "all_threads");
+		fprintf(out, "\t\t\t\"threads\": %d,\n", threadCounts[i] < 1 ? 1 : threadCounts[i]);
+		fprintf(out, "\t\t\t\"playouts\": %llu,\n", (unsigned long long)result.playouts);
+		fprintf(out, "\t\t\t\"nodes\": %zu,\n", result.nodes);
+		fprintf(out, "\t\t\t\"column\": %d,\n", result.column);
+		fprintf(out, "\t\t\t\"playouts_per_second\": %.0f\n", result.playouts / result.seconds);
+		fprintf(out, "\t\t}%s\n", i == 0 ? "," : "");
+	}
+
+	fprintf(out, "\t},\n");
+}
+
+//one frame every 16ms, the cursor wanders over the board and clicks now and then, and once in
+//a while Escape goes back to the menu
+static void GameFlow(FILE* out, std::mt19937_64& rng)
+{
+	constexpr uint64_t Frames = 1 << 24;
+	constexpr auto FrameInterval = std::chrono::microseconds(16667);
+
+	uint64_t gamesFinished = 0;
+	uint64_t gamesLeft = 0;
+	uint64_t moves = 0;
+	uint64_t checksum = 0;
+
+	GameState state;
+	std::chrono::nanoseconds now{};
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint64_t frame = 0; frame < Frames; frame++)
+	{
+		uint64_t random = rng();
+
+		GameInput input =
+		{
+			.column = (int)(random % (Width + 1)) - 1,
+			.button = (random >> 8) % 4 == 0 ? MenuButton::Exit : MenuButton::Play,
+			.click = (random >> 16) % 8 == 0,
+			.escape = (random >> 24) % 65536 == 0,
+			.cpuColumn = (int)((random >> 48) % Width)
+		};
+
+		state = StepGame(state, input, now);
+		now += FrameInterval;
+
+		moves += (state.events & (EventPlayerMoved | EventCPUMoved)) != 0;
+		gamesFinished += (state.events & EventGameFinished) != 0;
+		gamesLeft += (state.events & EventGameLeft) != 0;
+		checksum += state.board.Key();
+	}
+
+	double seconds = Seconds(start);
+	sink = checksum;
+
+	fprintf(out, "\t\"game_flow\": {\n");
+	fprintf(out, "\t\t\"frames\": %llu,\n", (unsigned long long)Frames);
+	fprintf(out, "\t\t\"moves\": %llu,\n", (unsigned long long)moves);
+	fprintf(out, "\t\t\"games_finished\": %llu,\n", (unsigned long long)gamesFinished);
+	fprintf(out, "\t\t\"games_left\": %llu,\n", (unsigned long long)gamesLeft);
+	fprintf(out, "\t\t\"simulated_seconds\": %.0f,\n", std::chrono::duration<double>(now).count());
+	fprintf(out, "\t\t\"frames_per_second\": %.0f\n", Frames / seconds);
+	fprintf(out, "\t},\n");
+}
+
+int main(int argc, char** argv)
+{
+	int positionCount = 20;
+	int gameCount = 10000;
+	size_t hashMegabytes = 256;
+	uint64_t seed = 1;
+	const char* outputPath = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-positions") == 0 && i + 1 < argc)
+			positionCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-games") == 0 && i + 1 < argc)
+			gameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outputPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-positions N] [-games N] [-hash MB] [-seed N] [-o FILE]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (positionCount < 1)
+		positionCount = 1;
+
+	if (gameCount < 1)
+		gameCount = 1;
+
+	FILE* out = outputPath ? fopen(outputPath, "w") : stdout;
+
+	if (out == nullptr)
+	{
+		fprintf(stderr, "unable to write %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937_64 rng(seed);
+
+	std::vector<std::vector<int>> games;
+	std::vector<Position> positions;
+
+	for (int i = 0; i < gameCount; i++)
+	{
+		games.push_back(RandomGame(rng));
+
+		//every position along the game except the finished one
+		Position position;
+		for (size_t j = 0; j + 1 < games.back().size(); j++)
+		{
+			position.Play(games.back()[j]);
+			positions.push_back(position);
+		}
+	}
+
+	TranspositionTable table(hashMegabytes << 20, true);
+
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"board\": \"%dx%d\",\n", Width, Height);
+	fprintf(out, "\t\"seed\": %llu,\n", (unsigned long long)seed);
+
+	WinDetection(out, games);
+	MoveGeneration(out, positions);
+	BatchEvaluation(out, positions);
+	Evaluation(out, positions, table);
+	SolveSets(out, table, rng, positionCount);
+	MCTSPlayouts(out);
+	GameFlow(out, rng);
+
+	fprintf(out, "\t\"table_probe\": {\n");
+	{
+		//fits in a typical L2 cache
+		TranspositionTable small(1 << 20);
+		TableProbe(out, "small", small, rng, false);
+	}
+	TableProbe(out, "full", table, rng, true);
+	fprintf(out, "\t}\n");
+
+	fprintf(out, "}\n");
+
+	if (out != stdout && fclose(out) != 0)
+	{
+		fprintf(stderr, "unable to write %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
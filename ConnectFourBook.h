@@ -0,0 +1,205 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "ConnectFourCore.h"
+#include "ConnectFourMappedFile.h"
+
+//opening book of exact scores, written by ConnectFourBookGen.cpp
+//
+//file layout, little endian:
+//
+//  BookHeader
+//  uint64_t entries[entryCount]   canonical key << 8 | (uint8_t)score, sorted ascending
+//
+//a position and its mirror image share one entry
+//
+//the file is memory mapped and searched in place, opening a book only checks the
+//header so it costs the same for a 1 KB book as for a 1 GB one
+
+namespace ConnectFour
+{
+	struct BookHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint8_t width;
+		uint8_t height;
+		//every position with this many stones or fewer that can be reached from the
+		//book's root (normally the empty board) is in the book
+		uint8_t maxStones;
+		uint8_t reserved[5];
+		uint64_t entryCount;
+	};
+
+	static_assert(sizeof(BookHeader) == 24);
+
+	constexpr char BookMagic[4] = { 'C', '4', 'B', 'K' };
+	constexpr uint32_t BookVersion = 2;
+
+	[[nodiscard]]
+	constexpr uint64_t PackBookEntry(Bitboard key, int score) noexcept
+	{
+		return (key << 8) | (uint8_t)(int8_t)score;
+	}
+
+	class OpeningBook
+	{
+	public:
+		OpeningBook() noexcept = default;
+
+		~OpeningBook()
+		{
+			Close();
+		}
+
+		OpeningBook(const OpeningBook&) = delete;
+		OpeningBook& operator=(const OpeningBook&) = delete;
+
+		//false if the file is missing or is not a book for this board size
+		[[nodiscard]]
+		bool Open(const char* path) noexcept
+		{
+			Close();
+
+			//binary search touches pages all over the file, read ahead would be wasted
+			if (!file.Open(path, MappedFile::Access::Random))
+				return false;
+
+			const BookHeader* header = (const BookHeader*)file.Data();
+
+			if (file.Size() < sizeof(BookHeader) ||
+				memcmp(header->magic, BookMagic, sizeof(BookMagic)) != 0 ||
+				header->version != BookVersion ||
+				header->width != Width ||
+				header->height != Height ||
+				header->entryCount > (file.Size() - sizeof(BookHeader)) / sizeof(uint64_t))
+			{
+				Close();
+				return false;
+			}
+
+			entries = (const uint64_t*)(header + 1);
+			entryCount = header->entryCount;
+			maxStones = header->maxStones;
+
+			return true;
+		}
+
+		void Close() noexcept
+		{
+			file.Close();
+
+			entries = nullptr;
+			entryCount = 0;
+			maxStones = -1;
+		}
+
+		[[nodiscard]]
+		bool IsOpen() const noexcept
+		{
+			return entries != nullptr;
+		}
+
+		[[nodiscard]]
+		int MaxStones() const noexcept
+		{
+			return maxStones;
+		}
+
+		[[nodiscard]]
+		uint64_t EntryCount() const noexcept
+		{
+			return entryCount;
+		}
+
+		[[nodiscard]]
+		bool Lookup(const Position& position, int& score) const noexcept
+		{
+			if (position.MoveCount() > maxStones)
+				return false;
+
+			uint64_t target = position.CanonicalKey() << 8;
+
+			uint64_t low = 0;
+			uint64_t high = entryCount;
+
+			while (low < high)
+			{
+				uint64_t middle = low + (high - low) / 2;
+
+				if (entries[middle] < target)
+					low = middle + 1;
+				else
+					high = middle;
+			}
+
+			if (low == entryCount || (entries[low] & ~uint64_t(0xFF)) != target)
+				return false;
+
+			score = (int8_t)(uint8_t)entries[low];
+			return true;
+		}
+
+		//only succeeds when every reply is in the book, so positions with fewer than MaxStones() stones
+		[[nodiscard]]
+		bool BestMove(const Position& position, int& column, int* scoreOut = nullptr) const noexcept
+		{
+			int bestColumn = -1;
+			int bestScore = -CellCount;
+
+			for (int x = 0; x < Width; x++)
+			{
+				if (!position.CanPlay(x))
+					continue;
+
+				int score;
+
+				if (position.IsWinningMove(x))
+				{
+					score = WinScore(position);
+				}
+				else
+				{
+					Position child = position;
+					child.Play(x);
+
+					if (!Lookup(child, score))
+						return false;
+
+					score = -score;
+				}
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestColumn = x;
+				}
+			}
+
+			if (bestColumn < 0)
+				return false;
+
+			column = bestColumn;
+
+			if (scoreOut)
+				*scoreOut = bestScore;
+
+			return true;
+		}
+
+	private:
+		MappedFile file;
+
+		const uint64_t* entries = nullptr;
+		uint64_t entryCount = 0;
+		int maxStones = -1;
+	};
+}
@@ -0,0 +1,235 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//opening book generator
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourBookGen.cpp -o ConnectFourBookGen
+//usage: ConnectFourBookGen [-depth N] [-threads N] [-hash MB] [-root MOVES] [-o FILE]
+//
+//collects every position reachable in at most depth stones after the root (the empty
+//board unless -root is given), solves the deepest layer on all threads and works out the
+//shallower layers from their children, then writes the sorted book ConnectFourBook.h maps.
+//positions where the side to move has already lost are never reached, the game ends first
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourSolver.h"
+
+using namespace ConnectFour;
+
+struct LayerEntry
+{
+	Position position;
+	int score;
+};
+
+[[nodiscard]]
+static bool KeyLess(const LayerEntry& a, const LayerEntry& b) noexcept
+{
+	return a.position.CanonicalKey() < b.position.CanonicalKey();
+}
+
+[[nodiscard]]
+static int FindScore(const std::vector<LayerEntry>& layer, const Position& position) noexcept
+{
+	LayerEntry target = { .position = position, .score = 0 };
+	auto found = std::lower_bound(layer.begin(), layer.end(), target, KeyLess);
+	return found->score;
+}
+
+int main(int argc, char** argv)
+{
+	int depth = 12;
+	int threadCount = (int)std::thread::hardware_concurrency();
+	size_t hashMegabytes = 1024;
+	const char* rootMoves = "";
+	const char* outputPath = "ConnectFour.book";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-depth") == 0 && i + 1 < argc)
+			depth = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-root") == 0 && i + 1 < argc)
+			rootMoves = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outputPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-depth N] [-threads N] [-hash MB] [-root MOVES] [-o FILE]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	Position root;
+
+	if (!PlayMoves(root, rootMoves))
+	{
+		fprintf(stderr, "invalid root moves: %s\n", rootMoves);
+		return EXIT_FAILURE;
+	}
+
+	int maxStones = root.MoveCount() + depth;
+
+	if (maxStones > CellCount)
+		maxStones = CellCount;
+
+	if (maxStones > 255)
+	{
+		fprintf(stderr, "depth too large\n");
+		return EXIT_FAILURE;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	//layers[i] holds the positions with root stones + i stones, sorted by canonical key with
+	//only one of each mirrored pair kept
+	std::vector<std::vector<LayerEntry>> layers(1);
+	layers[0].push_back({ .position = root, .score = 0 });
+
+	for (int stones = root.MoveCount(); stones < maxStones; stones++)
+	{
+		std::vector<LayerEntry> next;
+
+		for (const LayerEntry& entry : layers.back())
+		{
+			for (int x = 0; x < Width; x++)
+			{
+				//a winning move ends the game, there is nothing to store for the position after it
+				if (!entry.position.CanPlay(x) || entry.position.IsWinningMove(x))
+					continue;
+
+				Position child = entry.position;
+				child.Play(x);
+				next.push_back({ .position = child, .score = 0 });
+			}
+		}
+
+		std::sort(next.begin(), next.end(), KeyLess);
+		next.erase(std::unique(next.begin(), next.end(), [](const LayerEntry& a, const LayerEntry& b)
+		{
+			return a.position.CanonicalKey() == b.position.CanonicalKey();
+		}), next.end());
+
+		printf("%d stones: %zu positions\n", stones + 1, next.size());
+		layers.push_back(std::move(next));
+	}
+
+	//solve the deepest layer, every thread takes the next unsolved position
+	{
+		std::vector<LayerEntry>& deepest = layers.back();
+
+		TranspositionTable table(hashMegabytes << 20, true);
+		std::atomic<size_t> nextIndex = 0;
+		std::atomic<size_t> solved = 0;
+
+		auto worker = [&](int index)
+		{
+			Solver solver(table, index);
+
+			for (size_t i = nextIndex++; i < deepest.size(); i = nextIndex++)
+			{
+				const Position& position = deepest[i].position;
+				deepest[i].score = position.IsFull() ? 0 : solver.Solve(position);
+
+				size_t done = ++solved;
+				if (done % 1000 == 0)
+				{
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					printf("solved %zu / %zu (%.0f s)\n", done, deepest.size(), seconds);
+				}
+			}
+		};
+
+		std::vector<std::thread> helpers;
+		for (int i = 1; i < threadCount; i++)
+			helpers.emplace_back(worker, i);
+
+		worker(0);
+
+		for (std::thread& helper : helpers)
+			helper.join();
+	}
+
+	//every shallower score follows from the children one layer down
+	for (int i = (int)layers.size() - 2; i >= 0; i--)
+	{
+		for (LayerEntry& entry : layers[i])
+		{
+			int best = -CellCount;
+
+			for (int x = 0; x < Width; x++)
+			{
+				if (!entry.position.CanPlay(x))
+					continue;
+
+				int score;
+
+				if (entry.position.IsWinningMove(x))
+				{
+					score = WinScore(entry.position);
+				}
+				else
+				{
+					Position child = entry.position;
+					child.Play(x);
+					score = -FindScore(layers[i + 1], child);
+				}
+
+				best = std::max(best, score);
+			}
+
+			entry.score = best;
+		}
+	}
+
+	std::vector<uint64_t> entries;
+
+	for (const std::vector<LayerEntry>& layer : layers)
+	{
+		for (const LayerEntry& entry : layer)
+			entries.push_back(PackBookEntry(entry.position.CanonicalKey(), entry.score));
+	}
+
+	std::sort(entries.begin(), entries.end());
+
+	BookHeader header = {};
+	memcpy(header.magic, BookMagic, sizeof(BookMagic));
+	header.version = BookVersion;
+	header.width = Width;
+	header.height = Height;
+	header.maxStones = (uint8_t)maxStones;
+	header.entryCount = entries.size();
+
+	FILE* file = fopen(outputPath, "wb");
+
+	if (file == nullptr ||
+		fwrite(&header, sizeof(header), 1, file) != 1 ||
+		fwrite(entries.data(), sizeof(uint64_t), entries.size(), file) != entries.size() ||
+		fclose(file) != 0)
+	{
+		fprintf(stderr, "unable to write %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("wrote %zu positions (%zu bytes) to %s in %.1f s\n", entries.size(), sizeof(header) + entries.size() * sizeof(uint64_t), outputPath, seconds);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,720 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <bit>
+#include <initializer_list>
+#include <type_traits>
+
+#if __cplusplus < 202002L && !_HAS_CXX20
+#error C++20 is required
+#endif
+
+//platform independent game rules, no Win32 or Direct2D in here
+//
+//the board is stored as two bitboards, one bit per cell, column major. on the
+//standard 7x6 board:
+//
+//  .  .  .  .  .  .  .   <- sentinel row, always empty
+//  5 12 19 26 33 40 47
+//  4 11 18 25 32 39 46
+//  3 10 17 24 31 38 45
+//  2  9 16 23 30 37 44
+//  1  8 15 22 29 36 43
+//  0  7 14 21 28 35 42
+//
+//row 0 is the bottom of the board. the extra sentinel bit on top of every
+//column stops shifted runs from wrapping into the next column
+//
+//the rules are templates over width, height and the length of a winning line, with
+//every mask a compile time constant. Position is the standard game and everything
+//outside the core is written for it; other sizes use BasicPosition directly, boards
+//with more than 64 bits including sentinels on a 128 bit Bitboard128
+
+namespace ConnectFour
+{
+	//two 64 bit halves, for boards such as 9x7 that do not fit in one word
+	struct Bitboard128
+	{
+		uint64_t low = 0;
+		uint64_t high = 0;
+
+		constexpr Bitboard128() noexcept = default;
+
+		constexpr Bitboard128(uint64_t value) noexcept :
+			low(value)
+		{
+		}
+
+		constexpr Bitboard128(uint64_t low, uint64_t high) noexcept :
+			low(low),
+			high(high)
+		{
+		}
+
+		constexpr explicit operator bool() const noexcept
+		{
+			return (low | high) != 0;
+		}
+
+		friend constexpr bool operator==(const Bitboard128& a, const Bitboard128& b) noexcept = default;
+
+		friend constexpr bool operator<(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			return a.high != b.high ? a.high < b.high : a.low < b.low;
+		}
+
+		friend constexpr Bitboard128 operator&(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			return { a.low & b.low, a.high & b.high };
+		}
+
+		friend constexpr Bitboard128 operator|(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			return { a.low | b.low, a.high | b.high };
+		}
+
+		friend constexpr Bitboard128 operator^(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			return { a.low ^ b.low, a.high ^ b.high };
+		}
+
+		friend constexpr Bitboard128 operator~(const Bitboard128& a) noexcept
+		{
+			return { ~a.low, ~a.high };
+		}
+
+		friend constexpr Bitboard128 operator+(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			uint64_t low = a.low + b.low;
+			return { low, a.high + b.high + (low < a.low) };
+		}
+
+		friend constexpr Bitboard128 operator-(const Bitboard128& a, const Bitboard128& b) noexcept
+		{
+			return { a.low - b.low, a.high - b.high - (a.low < b.low) };
+		}
+
+		friend constexpr Bitboard128 operator<<(const Bitboard128& a, int shift) noexcept
+		{
+			if (shift == 0)
+				return a;
+
+			if (shift >= 64)
+				return { 0, a.low << (shift - 64) };
+
+			return { a.low << shift, (a.high << shift) | (a.low >> (64 - shift)) };
+		}
+
+		friend constexpr Bitboard128 operator>>(const Bitboard128& a, int shift) noexcept
+		{
+			if (shift == 0)
+				return a;
+
+			if (shift >= 64)
+				return { a.high >> (shift - 64), 0 };
+
+			return { (a.low >> shift) | (a.high << (64 - shift)), a.high >> shift };
+		}
+
+		constexpr Bitboard128& operator&=(const Bitboard128& other) noexcept { return *this = *this & other; }
+		constexpr Bitboard128& operator|=(const Bitboard128& other) noexcept { return *this = *this | other; }
+		constexpr Bitboard128& operator^=(const Bitboard128& other) noexcept { return *this = *this ^ other; }
+	};
+
+	[[nodiscard]]
+	constexpr int PopCount(uint64_t board) noexcept
+	{
+		return std::popcount(board);
+	}
+
+	[[nodiscard]]
+	constexpr int PopCount(const Bitboard128& board) noexcept
+	{
+		return std::popcount(board.low) + std::popcount(board.high);
+	}
+
+	//every mask and line test for one board size. connect is the length of a winning line
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	struct BoardGeometry
+	{
+		static constexpr int Width = BoardWidth;
+		static constexpr int Height = BoardHeight;
+		static constexpr int Connect = BoardConnect;
+		static constexpr int CellCount = Width * Height;
+
+		static_assert(Width >= 1 && Height >= 1 && Connect >= 2);
+		static_assert(Width * (Height + 1) <= 128, "board does not fit in a 128 bit bitboard");
+
+		using Bitboard = std::conditional_t<Width * (Height + 1) <= 64, uint64_t, Bitboard128>;
+
+		//bits in a key, see BasicPosition::Key()
+		static constexpr int KeyBits = Width * (Height + 1);
+
+		//scores are from the point of view of the side to move:
+		//  0   the game is a draw with perfect play
+		//  >0  the side to move wins, the sooner the higher (one point per stone left unplayed)
+		//  <0  the side to move loses, the later the higher
+		static constexpr int MinScore = -(CellCount / 2) + 3;
+		static constexpr int MaxScore = (CellCount + 1) / 2 - 3;
+
+		//the bit of a cell, see CellBit()
+		[[nodiscard]]
+		static constexpr int CellIndex(int column, int row) noexcept
+		{
+			return column * (Height + 1) + row;
+		}
+
+		[[nodiscard]]
+		static constexpr Bitboard CellBit(int column, int row) noexcept
+		{
+			return Bitboard(1) << CellIndex(column, row);
+		}
+
+		[[nodiscard]]
+		static constexpr Bitboard BottomMask(int column) noexcept
+		{
+			return CellBit(column, 0);
+		}
+
+		[[nodiscard]]
+		static constexpr Bitboard TopMask(int column) noexcept
+		{
+			return CellBit(column, Height - 1);
+		}
+
+		[[nodiscard]]
+		static constexpr Bitboard ColumnMask(int column) noexcept
+		{
+			return ((Bitboard(1) << Height) - 1) << (column * (Height + 1));
+		}
+
+		//a column including its sentinel bit
+		[[nodiscard]]
+		static constexpr Bitboard ColumnWithSentinelMask(int column) noexcept
+		{
+			return ((Bitboard(1) << (Height + 1)) - 1) << (column * (Height + 1));
+		}
+
+		static constexpr Bitboard BottomRow = []
+		{
+			Bitboard mask = 0;
+			for (int x = 0; x < Width; x++)
+				mask |= Bitboard(1) << (x * (Height + 1));
+			return mask;
+		}();
+
+		static constexpr Bitboard FullBoard = []
+		{
+			Bitboard mask = 0;
+			for (int x = 0; x < Width; x++)
+				mask |= ((Bitboard(1) << Height) - 1) << (x * (Height + 1));
+			return mask;
+		}();
+
+		//shift distances for the four directions a line can run in
+		static constexpr int DirectionVertical = 1;
+		static constexpr int DirectionHorizontal = Height + 1;
+		static constexpr int DirectionDiagonalUp = Height + 2;
+		static constexpr int DirectionDiagonalDown = Height;
+
+		//left-right mirror image, columns swap in pairs around the middle one
+		[[nodiscard]]
+		static constexpr Bitboard Mirror(Bitboard board) noexcept
+		{
+			Bitboard mirrored = (Width % 2) ? board & ColumnWithSentinelMask(Width / 2) : Bitboard(0);
+
+			for (int x = 0; x < Width / 2; x++)
+			{
+				int distance = (Width - 1 - 2 * x) * (Height + 1);
+				mirrored |= (board & ColumnWithSentinelMask(x)) << distance;
+				mirrored |= (board & ColumnWithSentinelMask(Width - 1 - x)) >> distance;
+			}
+
+			return mirrored;
+		}
+
+		//every bit left set is the lowest cell of a winning line. runs double in length
+		//each step, the last step only tops them up to Connect
+		template<int Shift, int Length = 1>
+		[[nodiscard]]
+		static constexpr Bitboard AlignmentsInDirection(Bitboard runs) noexcept
+		{
+			if constexpr (Length >= Connect)
+			{
+				return runs;
+			}
+			else
+			{
+				constexpr int Step = Length < Connect - Length ? Length : Connect - Length;
+				return AlignmentsInDirection<Shift, Length + Step>(runs & (runs >> (Step * Shift)));
+			}
+		}
+
+		//cells with Count stones in a row right behind them, going against the direction
+		template<int Shift, int Count>
+		[[nodiscard]]
+		static constexpr Bitboard StonesBehind(Bitboard stones) noexcept
+		{
+			if constexpr (Count == 0)
+				return ~Bitboard(0);
+			else
+				return (stones << (Count * Shift)) & StonesBehind<Shift, Count - 1>(stones);
+		}
+
+		//cells with Count stones in a row right ahead of them, going along the direction
+		template<int Shift, int Count>
+		[[nodiscard]]
+		static constexpr Bitboard StonesAhead(Bitboard stones) noexcept
+		{
+			if constexpr (Count == 0)
+				return ~Bitboard(0);
+			else
+				return (stones >> (Count * Shift)) & StonesAhead<Shift, Count - 1>(stones);
+		}
+
+		//a line with its empty cell Gap cells from the start, for every Gap from the given one on
+		template<int Shift, int Gap = 0>
+		[[nodiscard]]
+		static constexpr Bitboard LineSpots(Bitboard stones) noexcept
+		{
+			Bitboard spots = StonesBehind<Shift, Gap>(stones) & StonesAhead<Shift, Connect - 1 - Gap>(stones);
+
+			if constexpr (Gap + 1 < Connect)
+				return spots | LineSpots<Shift, Gap + 1>(stones);
+			else
+				return spots;
+		}
+
+		//the Connect cells of every line starting at starts
+		template<int Shift, int Count = Connect - 1>
+		[[nodiscard]]
+		static constexpr Bitboard LineCells(Bitboard starts) noexcept
+		{
+			if constexpr (Count == 0)
+				return starts;
+			else
+				return (starts << (Count * Shift)) | LineCells<Shift, Count - 1>(starts);
+		}
+
+		[[nodiscard]]
+		static constexpr bool HasAlignment(Bitboard stones) noexcept
+		{
+			return static_cast<bool>(
+				AlignmentsInDirection<DirectionVertical>(stones) |
+				AlignmentsInDirection<DirectionHorizontal>(stones) |
+				AlignmentsInDirection<DirectionDiagonalUp>(stones) |
+				AlignmentsInDirection<DirectionDiagonalDown>(stones));
+		}
+
+		//every cell that is part of at least one winning line
+		[[nodiscard]]
+		static constexpr Bitboard WinningCells(Bitboard stones) noexcept
+		{
+			return
+				LineCells<DirectionVertical>(AlignmentsInDirection<DirectionVertical>(stones)) |
+				LineCells<DirectionHorizontal>(AlignmentsInDirection<DirectionHorizontal>(stones)) |
+				LineCells<DirectionDiagonalUp>(AlignmentsInDirection<DirectionDiagonalUp>(stones)) |
+				LineCells<DirectionDiagonalDown>(AlignmentsInDirection<DirectionDiagonalDown>(stones));
+		}
+
+		//every line of Connect cells, horizontal ones first, then vertical, diagonal up and
+		//diagonal down, each kind numbered by the lowest leftmost cell column by column
+		static constexpr int LineCount =
+			(Width >= Connect ? (Width - Connect + 1) * Height : 0) +
+			(Height >= Connect ? Width * (Height - Connect + 1) : 0) +
+			(Width >= Connect && Height >= Connect ? 2 * (Width - Connect + 1) * (Height - Connect + 1) : 0);
+
+		//no cell is on more lines than this, Connect in each direction
+		static constexpr int MaxLinesPerCell = 4 * Connect;
+
+		struct LineTables
+		{
+			Bitboard lines[LineCount > 0 ? LineCount : 1];
+			//by bit index, the first cellLineCounts[bit] entries are the lines through the cell
+			uint16_t cellLines[KeyBits][MaxLinesPerCell];
+			uint8_t cellLineCounts[KeyBits];
+		};
+
+		static constexpr LineTables Lines = []
+		{
+			LineTables tables = {};
+			int line = 0;
+
+			auto add = [&](int x, int y, int dx, int dy)
+			{
+				for (int i = 0; i < Connect; i++)
+				{
+					int bit = (x + dx * i) * (Height + 1) + y + dy * i;
+
+					tables.lines[line] |= Bitboard(1) << bit;
+					tables.cellLines[bit][tables.cellLineCounts[bit]++] = (uint16_t)line;
+				}
+
+				line++;
+			};
+
+			for (int x = 0; x + Connect <= Width; x++)
+				for (int y = 0; y < Height; y++)
+					add(x, y, 1, 0);
+
+			for (int x = 0; x < Width; x++)
+				for (int y = 0; y + Connect <= Height; y++)
+					add(x, y, 0, 1);
+
+			for (int x = 0; x + Connect <= Width; x++)
+				for (int y = 0; y + Connect <= Height; y++)
+					add(x, y, 1, 1);
+
+			for (int x = 0; x + Connect <= Width; x++)
+				for (int y = Connect - 1; y < Height; y++)
+					add(x, y, 1, -1);
+
+			return tables;
+		}();
+
+		//the cells of every line through the cell at bit that stones fill, empty if the stone
+		//there did not win. a table lookup and two ANDs per line rather than a scan of the board
+		[[nodiscard]]
+		static constexpr Bitboard WinningLinesThrough(Bitboard stones, int bit) noexcept
+		{
+			Bitboard cells = 0;
+
+			for (int i = 0; i < Lines.cellLineCounts[bit]; i++)
+			{
+				Bitboard line = Lines.lines[Lines.cellLines[bit][i]];
+
+				if ((stones & line) == line)
+					cells |= line;
+			}
+
+			return cells;
+		}
+
+		//empty cells that would complete a winning line for stones
+		[[nodiscard]]
+		static constexpr Bitboard WinningSpots(Bitboard stones, Bitboard occupied) noexcept
+		{
+			//vertical, the only empty cell of a column line is the top one
+			Bitboard spots = StonesBehind<DirectionVertical, Connect - 1>(stones);
+
+			if constexpr (Connect == 4)
+			{
+				for (int shift : { DirectionHorizontal, DirectionDiagonalUp, DirectionDiagonalDown })
+				{
+					Bitboard pair = (stones << shift) & (stones << (2 * shift));
+					spots |= pair & (stones << (3 * shift));//xxx.
+					spots |= pair & (stones >> shift);//xx.x
+
+					pair = (stones >> shift) & (stones >> (2 * shift));
+					spots |= pair & (stones >> (3 * shift));//.xxx
+					spots |= pair & (stones << shift);//x.xx
+				}
+			}
+			else
+			{
+				spots |= LineSpots<DirectionHorizontal>(stones);
+				spots |= LineSpots<DirectionDiagonalUp>(stones);
+				spots |= LineSpots<DirectionDiagonalDown>(stones);
+			}
+
+			return spots & (FullBoard ^ occupied);
+		}
+	};
+
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	class BasicPosition
+	{
+	public:
+		using Geometry = BoardGeometry<BoardWidth, BoardHeight, BoardConnect>;
+		using Bitboard = typename Geometry::Bitboard;
+
+		[[nodiscard]]
+		constexpr bool CanPlay(int column) const noexcept
+		{
+			return !(mask & Geometry::TopMask(column));
+		}
+
+		//column must be playable
+		constexpr void Play(int column) noexcept
+		{
+			current ^= mask;
+			mask |= mask + Geometry::BottomMask(column);
+			moves++;
+		}
+
+		//move is a single bit from PossibleMoves()
+		constexpr void Play(Bitboard move) noexcept
+		{
+			current ^= mask;
+			mask |= move;
+			moves++;
+		}
+
+		//column must be the column of the last move played
+		constexpr void Undo(int column) noexcept
+		{
+			Bitboard top = ((mask & Geometry::ColumnMask(column)) + Geometry::BottomMask(column)) >> 1;
+			Undo(top);
+		}
+
+		//move must be the bit of the last move played
+		constexpr void Undo(Bitboard move) noexcept
+		{
+			mask ^= move;
+			current ^= mask;
+			moves--;
+		}
+
+		//one bit for the landing cell of every column that is not full
+		[[nodiscard]]
+		constexpr Bitboard PossibleMoves() const noexcept
+		{
+			return (mask + Geometry::BottomRow) & Geometry::FullBoard;
+		}
+
+		[[nodiscard]]
+		constexpr bool CanWinNext() const noexcept
+		{
+			return static_cast<bool>(Geometry::WinningSpots(current, mask) & PossibleMoves());
+		}
+
+		//moves that do not hand the opponent an immediate win, only valid when the
+		//side to move cannot win right away
+		[[nodiscard]]
+		constexpr Bitboard PossibleNonLosingMoves() const noexcept
+		{
+			Bitboard possible = PossibleMoves();
+			Bitboard opponentWins = Geometry::WinningSpots(current ^ mask, mask);
+			Bitboard forced = possible & opponentWins;
+
+			if (forced)
+			{
+				//two threats at once can not both be blocked
+				if (forced & (forced - 1))
+					return 0;
+
+				possible = forced;
+			}
+
+			//never play directly underneath an opponent threat
+			return possible & ~(opponentWins >> 1);
+		}
+
+		[[nodiscard]]
+		constexpr bool IsWinningMove(int column) const noexcept
+		{
+			Bitboard stone = (mask + Geometry::BottomMask(column)) & Geometry::ColumnMask(column);
+			return Geometry::HasAlignment(current | stone);
+		}
+
+		//number of stones already in the column, which is also the row a new stone lands on
+		[[nodiscard]]
+		constexpr int ColumnHeight(int column) const noexcept
+		{
+			return PopCount(mask & Geometry::ColumnMask(column));
+		}
+
+		[[nodiscard]]
+		constexpr int MoveCount() const noexcept
+		{
+			return moves;
+		}
+
+		[[nodiscard]]
+		constexpr bool IsFull() const noexcept
+		{
+			return moves == Geometry::CellCount;
+		}
+
+		//stones of the player about to move
+		[[nodiscard]]
+		constexpr Bitboard CurrentStones() const noexcept
+		{
+			return current;
+		}
+
+		//stones of the player who moved last
+		[[nodiscard]]
+		constexpr Bitboard OpponentStones() const noexcept
+		{
+			return current ^ mask;
+		}
+
+		//player 0 is whoever moved first
+		[[nodiscard]]
+		constexpr Bitboard PlayerStones(int player) const noexcept
+		{
+			return (moves & 1) == player ? current : current ^ mask;
+		}
+
+		[[nodiscard]]
+		constexpr Bitboard Occupied() const noexcept
+		{
+			return mask;
+		}
+
+		//unique for every position on the board
+		[[nodiscard]]
+		constexpr Bitboard Key() const noexcept
+		{
+			return current + mask;
+		}
+
+		//same for a position and its mirror image, which always have the same score.
+		//the addition in Key() never carries out of a column, so mirroring the key
+		//mirrors the position
+		[[nodiscard]]
+		constexpr Bitboard CanonicalKey() const noexcept
+		{
+			Bitboard key = Key();
+			Bitboard mirrored = Geometry::Mirror(key);
+			return mirrored < key ? mirrored : key;
+		}
+
+		//the position a key was taken from. adding the bottom row to a key leaves the
+		//stones of the side to move under one marker bit on top of every column
+		[[nodiscard]]
+		static constexpr BasicPosition FromKey(Bitboard key) noexcept
+		{
+			BasicPosition position;
+			Bitboard marked = key + Geometry::BottomRow;
+
+			for (int column = 0; column < BoardWidth; column++)
+			{
+				int height = BoardHeight;
+
+				while (height > 0 && !(marked & Geometry::CellBit(column, height)))
+					height--;
+
+				for (int row = 0; row < height; row++)
+					position.mask |= Geometry::CellBit(column, row);
+			}
+
+			position.current = marked & position.mask;
+			position.moves = PopCount(position.mask);
+			return position;
+		}
+
+	private:
+		Bitboard current = 0;
+		Bitboard mask = 0;
+		int moves = 0;
+	};
+
+	//score of winning with the next stone
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	[[nodiscard]]
+	constexpr int WinScore(const BasicPosition<BoardWidth, BoardHeight, BoardConnect>& position) noexcept
+	{
+		return (BoardWidth * BoardHeight + 1 - position.MoveCount()) / 2;
+	}
+
+	//plays a move string of 1 based column digits such as "4453", stops at the first
+	//character that is not a playable column or at a move that would end the game
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	[[nodiscard]]
+	constexpr bool PlayMoves(BasicPosition<BoardWidth, BoardHeight, BoardConnect>& position, const char* moves) noexcept
+	{
+		for (; *moves != '\0'; moves++)
+		{
+			int column = *moves - '1';
+
+			if (column < 0 || column >= BoardWidth || !position.CanPlay(column) || position.IsWinningMove(column))
+				return false;
+
+			position.Play(column);
+		}
+
+		return true;
+	}
+
+	//the standard game
+	using StandardGeometry = BoardGeometry<7, 6, 4>;
+	using Position = BasicPosition<7, 6, 4>;
+
+	using Bitboard = StandardGeometry::Bitboard;
+
+	constexpr int Width = StandardGeometry::Width;
+	constexpr int Height = StandardGeometry::Height;
+	constexpr int Connect = StandardGeometry::Connect;
+	constexpr int CellCount = StandardGeometry::CellCount;
+
+	constexpr int MinScore = StandardGeometry::MinScore;
+	constexpr int MaxScore = StandardGeometry::MaxScore;
+
+	constexpr Bitboard BottomRow = StandardGeometry::BottomRow;
+	constexpr Bitboard FullBoard = StandardGeometry::FullBoard;
+
+	constexpr int DirectionVertical = StandardGeometry::DirectionVertical;
+	constexpr int DirectionHorizontal = StandardGeometry::DirectionHorizontal;
+	constexpr int DirectionDiagonalUp = StandardGeometry::DirectionDiagonalUp;
+	constexpr int DirectionDiagonalDown = StandardGeometry::DirectionDiagonalDown;
+
+	constexpr int LineCount = StandardGeometry::LineCount;
+
+	[[nodiscard]]
+	constexpr int CellIndex(int column, int row) noexcept
+	{
+		return StandardGeometry::CellIndex(column, row);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard CellBit(int column, int row) noexcept
+	{
+		return StandardGeometry::CellBit(column, row);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard BottomMask(int column) noexcept
+	{
+		return StandardGeometry::BottomMask(column);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard TopMask(int column) noexcept
+	{
+		return StandardGeometry::TopMask(column);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard ColumnMask(int column) noexcept
+	{
+		return StandardGeometry::ColumnMask(column);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard Mirror(Bitboard board) noexcept
+	{
+		return StandardGeometry::Mirror(board);
+	}
+
+	[[nodiscard]]
+	constexpr bool HasAlignment(Bitboard stones) noexcept
+	{
+		return StandardGeometry::HasAlignment(stones);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard WinningCells(Bitboard stones) noexcept
+	{
+		return StandardGeometry::WinningCells(stones);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard WinningLinesThrough(Bitboard stones, int bit) noexcept
+	{
+		return StandardGeometry::WinningLinesThrough(stones, bit);
+	}
+
+	[[nodiscard]]
+	constexpr Bitboard WinningSpots(Bitboard stones, Bitboard occupied) noexcept
+	{
+		return StandardGeometry::WinningSpots(stones, occupied);
+	}
+}
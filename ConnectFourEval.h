@@ -0,0 +1,407 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <bit>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CONNECTFOUR_EVAL_X86 1
+#include <immintrin.h>
+#endif
+
+#include "ConnectFourCore.h"
+
+//static evaluation for depth limited search, from the point of view of the side to move
+//
+//every line of Connect cells that could still be completed scores by how many stones it
+//holds: a line with stones of only one side scores that side's weight for that many
+//stones, lines with both or neither score nothing. every stone also scores the weight of
+//its cell. weights are kept apart for the side to move and the side that just moved,
+//which is how having the move is valued
+//
+//the evaluator keeps an accumulator of stones per line for each side as int16 lanes, one
+//lane a line, so a move is one vector add of the lines through its cell and Evaluate()
+//is a few compares and adds per vector. SSE2 is always there on x86-64, AVX2 is used when
+//compiled for it, anything else runs the same loops one lane at a time
+//
+//weights file, little endian:
+//
+//  EvalFileHeader
+//  int16_t mine[Connect][lineCount]     weight of a line holding 0 to Connect - 1 stones of
+//  int16_t theirs[Connect][lineCount]   only the side to move, or of only the other side
+//  int16_t cells[cellCount]             column by column, from the bottom
+//
+//lines are numbered as in BoardGeometry::Lines, the tables the rules use to find a win
+
+namespace ConnectFour
+{
+	struct EvalFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint8_t width;
+		uint8_t height;
+		uint8_t connect;
+		uint8_t reserved;
+		uint16_t lineCount;
+		uint16_t cellCount;
+		//raw evaluations are divided by this to get a score in the solver's units
+		int32_t scale;
+		uint32_t reserved2;
+	};
+
+	static_assert(sizeof(EvalFileHeader) == 24);
+
+	constexpr char EvalFileMagic[4] = { 'C', '4', 'E', 'V' };
+	constexpr uint32_t EvalFileVersion = 1;
+
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	struct BasicEvalWeights
+	{
+		using Geometry = BoardGeometry<BoardWidth, BoardHeight, BoardConnect>;
+
+		static constexpr int Connect = BoardConnect;
+		static constexpr int CellCount = Geometry::CellCount;
+
+		static constexpr int LineCount = Geometry::LineCount;
+
+		//lines padded to whole AVX2 vectors, the padding lanes never hold a stone
+		static constexpr int LaneCount = (LineCount + 15) / 16 * 16;
+
+		alignas(32) int16_t mine[Connect][LaneCount] = {};
+		alignas(32) int16_t theirs[Connect][LaneCount] = {};
+		//by bit index, see Geometry::CellBit()
+		int16_t cells[Geometry::KeyBits] = {};
+		int32_t scale = 1;
+
+		//lines worth more the fuller they are, a little more for the side to move, and
+		//cells worth the number of lines through them
+		[[nodiscard]]
+		static constexpr BasicEvalWeights Default() noexcept
+		{
+			constexpr int16_t MineWeights[] = { 0, 2, 8, 32, 128, 512, 2048 };
+			constexpr int16_t TheirWeights[] = { 0, 2, 6, 24, 96, 384, 1536 };
+
+			BasicEvalWeights weights;
+
+			for (int count = 1; count < Connect; count++)
+			{
+				for (int line = 0; line < LineCount; line++)
+				{
+					weights.mine[count][line] = MineWeights[count < 7 ? count : 6];
+					weights.theirs[count][line] = TheirWeights[count < 7 ? count : 6];
+				}
+			}
+
+			for (int bit = 0; bit < Geometry::KeyBits; bit++)
+				weights.cells[bit] = Geometry::Lines.cellLineCounts[bit];
+
+			//a three in a row against nothing is about one point
+			weights.scale = MineWeights[Connect - 1 < 7 ? Connect - 1 : 6];
+
+			return weights;
+		}
+
+		//false if the file is missing or is not for this board, the weights are left as they were
+		[[nodiscard]]
+		bool Load(const char* path) noexcept
+		{
+			FILE* file = fopen(path, "rb");
+
+			if (file == nullptr)
+				return false;
+
+			EvalFileHeader header;
+			BasicEvalWeights loaded;
+
+			bool read = fread(&header, sizeof(header), 1, file) == 1 &&
+				memcmp(header.magic, EvalFileMagic, sizeof(EvalFileMagic)) == 0 &&
+				header.version == EvalFileVersion &&
+				header.width == BoardWidth &&
+				header.height == BoardHeight &&
+				header.connect == BoardConnect &&
+				header.lineCount == LineCount &&
+				header.cellCount == CellCount &&
+				header.scale > 0;
+
+			for (int count = 0; read && count < Connect; count++)
+				read = fread(loaded.mine[count], sizeof(int16_t), LineCount, file) == (size_t)LineCount;
+
+			for (int count = 0; read && count < Connect; count++)
+				read = fread(loaded.theirs[count], sizeof(int16_t), LineCount, file) == (size_t)LineCount;
+
+			for (int x = 0; read && x < BoardWidth; x++)
+				read = fread(&loaded.cells[x * (BoardHeight + 1)], sizeof(int16_t), BoardHeight, file) == (size_t)BoardHeight;
+
+			fclose(file);
+
+			if (!read)
+				return false;
+
+			loaded.scale = header.scale;
+			*this = loaded;
+			return true;
+		}
+
+		[[nodiscard]]
+		bool Save(const char* path) const noexcept
+		{
+			FILE* file = fopen(path, "wb");
+
+			if (file == nullptr)
+				return false;
+
+			EvalFileHeader header = {
+				.magic = { EvalFileMagic[0], EvalFileMagic[1], EvalFileMagic[2], EvalFileMagic[3] },
+				.version = EvalFileVersion,
+				.width = BoardWidth,
+				.height = BoardHeight,
+				.connect = BoardConnect,
+				.reserved = 0,
+				.lineCount = LineCount,
+				.cellCount = CellCount,
+				.scale = scale,
+				.reserved2 = 0
+			};
+
+			bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+			for (int count = 0; written && count < Connect; count++)
+				written = fwrite(mine[count], sizeof(int16_t), LineCount, file) == (size_t)LineCount;
+
+			for (int count = 0; written && count < Connect; count++)
+				written = fwrite(theirs[count], sizeof(int16_t), LineCount, file) == (size_t)LineCount;
+
+			for (int x = 0; written && x < BoardWidth; x++)
+				written = fwrite(&cells[x * (BoardHeight + 1)], sizeof(int16_t), BoardHeight, file) == (size_t)BoardHeight;
+
+			return fclose(file) == 0 && written;
+		}
+	};
+
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	class BasicEvaluator
+	{
+	public:
+		using Weights = BasicEvalWeights<BoardWidth, BoardHeight, BoardConnect>;
+		using Position = BasicPosition<BoardWidth, BoardHeight, BoardConnect>;
+		using Geometry = typename Position::Geometry;
+		using Bitboard = typename Geometry::Bitboard;
+
+		static constexpr int LaneCount = Weights::LaneCount;
+
+		//the weights have to outlive the evaluator, and be set before anything else is called
+		void UseWeights(const Weights* evalWeights) noexcept
+		{
+			weights = evalWeights;
+		}
+
+		//starts over from a position
+		void Refresh(const Position& position) noexcept
+		{
+			memset(lines, 0, sizeof(lines));
+			cellScores[0] = 0;
+			cellScores[1] = 0;
+
+			for (int player = 0; player < 2; player++)
+			{
+				Bitboard stones = position.PlayerStones(player);
+
+				for (int bit = 0; bit < Geometry::KeyBits; bit++)
+				{
+					if (stones & (Bitboard(1) << bit))
+						Add(bit, player);
+				}
+			}
+		}
+
+		//player 0 moves first. move is a single bit, as passed to Position::Play()
+		void Play(Bitboard move, int player) noexcept
+		{
+			Add(BitIndex(move), player);
+		}
+
+		void Undo(Bitboard move, int player) noexcept
+		{
+			int bit = BitIndex(move);
+			const int16_t* membership = LineMembership.lanes[bit];
+
+			for (int i = 0; i < LaneCount; i += VectorLanes)
+				Subtract(&lines[player][i], &membership[i]);
+
+			cellScores[player] -= weights->cells[bit];
+		}
+
+		//raw evaluation for the side to move, divide by Scale() for solver units
+		[[nodiscard]]
+		int Evaluate(int sideToMove) const noexcept
+		{
+			const int16_t* mine = lines[sideToMove];
+			const int16_t* theirs = lines[sideToMove ^ 1];
+
+			int score = cellScores[sideToMove] - cellScores[sideToMove ^ 1];
+
+#if defined(CONNECTFOUR_EVAL_X86) && defined(__AVX2__)
+			__m256i total = _mm256_setzero_si256();
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i ones = _mm256_set1_epi16(1);
+
+			for (int i = 0; i < LaneCount; i += 16)
+			{
+				__m256i me = _mm256_load_si256((const __m256i*)&mine[i]);
+				__m256i them = _mm256_load_si256((const __m256i*)&theirs[i]);
+				__m256i onlyMe = _mm256_cmpeq_epi16(them, zero);
+				__m256i onlyThem = _mm256_cmpeq_epi16(me, zero);
+				__m256i lineScores = zero;
+
+				for (int count = 1; count < BoardConnect; count++)
+				{
+					__m256i n = _mm256_set1_epi16((int16_t)count);
+					__m256i mineHit = _mm256_and_si256(_mm256_cmpeq_epi16(me, n), onlyMe);
+					__m256i theirHit = _mm256_and_si256(_mm256_cmpeq_epi16(them, n), onlyThem);
+
+					lineScores = _mm256_add_epi16(lineScores, _mm256_and_si256(mineHit, _mm256_load_si256((const __m256i*)&weights->mine[count][i])));
+					lineScores = _mm256_sub_epi16(lineScores, _mm256_and_si256(theirHit, _mm256_load_si256((const __m256i*)&weights->theirs[count][i])));
+				}
+
+				//pairs of lanes widened to int32 before they are summed
+				total = _mm256_add_epi32(total, _mm256_madd_epi16(lineScores, ones));
+			}
+
+			__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			score += _mm_cvtsi128_si32(sum);
+#elif defined(CONNECTFOUR_EVAL_X86)
+			__m128i total = _mm_setzero_si128();
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i ones = _mm_set1_epi16(1);
+
+			for (int i = 0; i < LaneCount; i += 8)
+			{
+				__m128i me = _mm_load_si128((const __m128i*)&mine[i]);
+				__m128i them = _mm_load_si128((const __m128i*)&theirs[i]);
+				__m128i onlyMe = _mm_cmpeq_epi16(them, zero);
+				__m128i onlyThem = _mm_cmpeq_epi16(me, zero);
+				__m128i lineScores = zero;
+
+				for (int count = 1; count < BoardConnect; count++)
+				{
+					__m128i n = _mm_set1_epi16((int16_t)count);
+					__m128i mineHit = _mm_and_si128(_mm_cmpeq_epi16(me, n), onlyMe);
+					__m128i theirHit = _mm_and_si128(_mm_cmpeq_epi16(them, n), onlyThem);
+
+					lineScores = _mm_add_epi16(lineScores, _mm_and_si128(mineHit, _mm_load_si128((const __m128i*)&weights->mine[count][i])));
+					lineScores = _mm_sub_epi16(lineScores, _mm_and_si128(theirHit, _mm_load_si128((const __m128i*)&weights->theirs[count][i])));
+				}
+
+				total = _mm_add_epi32(total, _mm_madd_epi16(lineScores, ones));
+			}
+
+			total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+			total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+			score += _mm_cvtsi128_si32(total);
+#else
+			for (int i = 0; i < LaneCount; i++)
+			{
+				if (theirs[i] == 0 && mine[i] > 0 && mine[i] < BoardConnect)
+					score += weights->mine[mine[i]][i];
+				else if (mine[i] == 0 && theirs[i] > 0 && theirs[i] < BoardConnect)
+					score -= weights->theirs[theirs[i]][i];
+			}
+#endif
+
+			return score;
+		}
+
+		[[nodiscard]]
+		int Scale() const noexcept
+		{
+			return weights->scale;
+		}
+
+	private:
+#if defined(CONNECTFOUR_EVAL_X86) && defined(__AVX2__)
+		static constexpr int VectorLanes = 16;
+#elif defined(CONNECTFOUR_EVAL_X86)
+		static constexpr int VectorLanes = 8;
+#else
+		static constexpr int VectorLanes = 1;
+#endif
+
+		//1 in the lane of every line through a cell, by bit index
+		struct Membership
+		{
+			alignas(32) int16_t lanes[Geometry::KeyBits][LaneCount] = {};
+		};
+
+		static constexpr Membership LineMembership = []
+		{
+			Membership membership;
+
+			for (int bit = 0; bit < Geometry::KeyBits; bit++)
+				for (int i = 0; i < Geometry::Lines.cellLineCounts[bit]; i++)
+					membership.lanes[bit][Geometry::Lines.cellLines[bit][i]] = 1;
+
+			return membership;
+		}();
+
+		[[nodiscard]]
+		static int BitIndex(Bitboard move) noexcept
+		{
+			if constexpr (std::is_same_v<Bitboard, Bitboard128>)
+				return move.low != 0 ? std::countr_zero(move.low) : 64 + std::countr_zero(move.high);
+			else
+				return std::countr_zero(move);
+		}
+
+		static void Increase(int16_t* lanes, const int16_t* add) noexcept
+		{
+#if defined(CONNECTFOUR_EVAL_X86) && defined(__AVX2__)
+			_mm256_store_si256((__m256i*)lanes, _mm256_add_epi16(_mm256_load_si256((const __m256i*)lanes), _mm256_load_si256((const __m256i*)add)));
+#elif defined(CONNECTFOUR_EVAL_X86)
+			_mm_store_si128((__m128i*)lanes, _mm_add_epi16(_mm_load_si128((const __m128i*)lanes), _mm_load_si128((const __m128i*)add)));
+#else
+			*lanes += *add;
+#endif
+		}
+
+		static void Subtract(int16_t* lanes, const int16_t* subtract) noexcept
+		{
+#if defined(CONNECTFOUR_EVAL_X86) && defined(__AVX2__)
+			_mm256_store_si256((__m256i*)lanes, _mm256_sub_epi16(_mm256_load_si256((const __m256i*)lanes), _mm256_load_si256((const __m256i*)subtract)));
+#elif defined(CONNECTFOUR_EVAL_X86)
+			_mm_store_si128((__m128i*)lanes, _mm_sub_epi16(_mm_load_si128((const __m128i*)lanes), _mm_load_si128((const __m128i*)subtract)));
+#else
+			*lanes -= *subtract;
+#endif
+		}
+
+		void Add(int bit, int player) noexcept
+		{
+			const int16_t* membership = LineMembership.lanes[bit];
+
+			for (int i = 0; i < LaneCount; i += VectorLanes)
+				Increase(&lines[player][i], &membership[i]);
+
+			cellScores[player] += weights->cells[bit];
+		}
+
+		const Weights* weights = nullptr;
+
+		//stones of each player on every line, player 0 moves first
+		alignas(32) int16_t lines[2][LaneCount] = {};
+		int cellScores[2] = {};
+	};
+
+	using EvalWeights = BasicEvalWeights<Width, Height, Connect>;
+	using Evaluator = BasicEvaluator<Width, Height, Connect>;
+}
@@ -0,0 +1,102 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <chrono>
+
+//decides when the next frame has to be drawn, so the message loop can sleep until then
+//
+//a frame is due at once after Invalidate(), at a given time after RequestFrameAt(), and
+//never if neither was called since the last BeginFrame(): a static screen costs nothing.
+//animations ask for their next frame after drawing each one. the clock is a template
+//parameter with a now() member, so the scheduler runs against a fake clock as easily as
+//against std::chrono::steady_clock, and has no Win32 in it
+
+namespace ConnectFour
+{
+	template<typename Clock = std::chrono::steady_clock>
+	class BasicFrameScheduler
+	{
+	public:
+		using TimePoint = typename Clock::time_point;
+		using Duration = typename Clock::duration;
+
+		//about 60 frames a second, presenting waits for the display anyway
+		static constexpr Duration DefaultFrameInterval = std::chrono::duration_cast<Duration>(std::chrono::microseconds(16667));
+
+		explicit BasicFrameScheduler(Clock clock = Clock(), Duration frameInterval = DefaultFrameInterval) noexcept :
+			clock(clock),
+			frameInterval(frameInterval)
+		{
+		}
+
+		//something on screen changed, draw as soon as possible
+		void Invalidate() noexcept
+		{
+			dirty = true;
+		}
+
+		//an animation needs a frame by this time, the earliest request wins
+		void RequestFrameAt(TimePoint time) noexcept
+		{
+			if (time < deadline)
+				deadline = time;
+		}
+
+		//the next frame of a continuous animation, one frame interval after the last frame began
+		void RequestAnimationFrame() noexcept
+		{
+			RequestFrameAt(lastFrame + frameInterval);
+		}
+
+		//a frame is being drawn, everything asked for so far is taken care of
+		void BeginFrame() noexcept
+		{
+			dirty = false;
+			deadline = (TimePoint::max)();
+			lastFrame = clock.now();
+		}
+
+		[[nodiscard]]
+		bool FrameDue() const noexcept
+		{
+			return dirty || (deadline != (TimePoint::max)() && clock.now() >= deadline);
+		}
+
+		//zero when a frame is due, Duration::max() when none is asked for
+		[[nodiscard]]
+		Duration TimeUntilFrame() const noexcept
+		{
+			if (dirty)
+				return Duration::zero();
+
+			if (deadline == (TimePoint::max)())
+				return (Duration::max)();
+
+			TimePoint now = clock.now();
+			return deadline > now ? deadline - now : Duration::zero();
+		}
+
+		[[nodiscard]]
+		TimePoint Now() const noexcept
+		{
+			return clock.now();
+		}
+
+	private:
+		Clock clock;
+		Duration frameInterval;
+
+		bool dirty = true;
+
+		//no frame asked for. max is parenthesized here and above against Windows.h's max macro
+		TimePoint deadline = (TimePoint::max)();
+		TimePoint lastFrame = {};
+	};
+
+	using FrameScheduler = BasicFrameScheduler<>;
+}
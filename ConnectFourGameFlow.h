@@ -0,0 +1,248 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "ConnectFourRecord.h"
+
+//the game's flow from the menu through every move and animation to the end of each game
+//
+//StepGame() takes the state, the input since the last step and the time, and returns the
+//next state. it keeps no globals and makes no system calls: the window turns the cursor and
+//keyboard into a GameInput, passes the engine's move in when it is the CPU's turn, reads the
+//clock and draws whatever the state holds. what the caller has to do outside, thinking about
+//a reply or archiving a game, is reported in GameState::events.
+//
+//the same inputs at the same times always give the same game, whatever the frame rate, so the
+//whole flow replays exactly and runs headless far faster than it is played
+
+namespace ConnectFour
+{
+	enum class GamePhase : uint8_t
+	{
+		Menu = 0,
+		PlayerTurn = 1,
+		CPUTurn = 2,
+		PieceFalling = 3,
+		GameOver = 4
+	};
+
+	enum class MenuButton : uint8_t
+	{
+		None = 0,
+		Play = 1,
+		Exit = 2
+	};
+
+	//GameState::events bits, what the last step did
+	constexpr uint8_t EventPlayerMoved = 1;  //the player's piece started falling in fallingColumn
+	constexpr uint8_t EventCPUMoved = 2;     //the CPU's piece started falling in fallingColumn
+	constexpr uint8_t EventGameFinished = 4; //record holds the finished game
+	constexpr uint8_t EventGameLeft = 8;     //Escape went back to the menu, record holds what was played
+	constexpr uint8_t EventExit = 16;        //EXIT was clicked
+
+	struct GameInput
+	{
+		//the board column under the cursor, -1 when it is off the board
+		int column = -1;
+
+		//the menu button under the cursor
+		MenuButton button = MenuButton::None;
+
+		bool click = false;
+		bool escape = false;
+
+		//the CPU's move, only read on the CPU's turn, -1 while it has none
+		int cpuColumn = -1;
+	};
+
+	struct GameTiming
+	{
+		//rows a falling piece crosses per second
+		float fallRowsPerSecond = 17.5f;
+
+		//how long a finished game stays on the board
+		std::chrono::nanoseconds gameOverDuration = std::chrono::seconds(1);
+
+		//the winning line is lit for half of every period
+		std::chrono::nanoseconds blinkPeriod = std::chrono::milliseconds(150);
+	};
+
+	struct GameState
+	{
+		GamePhase phase = GamePhase::Menu;
+
+		//the player always moves first
+		Position board;
+		GameRecord record = {};
+
+		int playerScore = 0;
+		int cpuScore = 0;
+
+		//cells to flash once a game has been won
+		Bitboard winningPieces = 0;
+		bool highlightWinningPieces = false;
+
+		//1 for the player's piece, 2 for the CPU's. rows count down from the top of the board,
+		//the piece starts centered a row above it and lands when it passes the center of targetRow
+		uint8_t fallingPiece = 0;
+		int fallingColumn = 0;
+		int fallingTargetRow = 0;
+		float fallingRow = 0;
+
+		std::chrono::nanoseconds fallStarted{};
+		std::chrono::nanoseconds gameOverUntil{};
+
+		uint8_t events = 0;
+	};
+
+	namespace Detail
+	{
+		inline void StartFalling(GameState& state, int column, uint8_t piece, std::chrono::nanoseconds now) noexcept
+		{
+			state.phase = GamePhase::PieceFalling;
+			state.fallingPiece = piece;
+			state.fallingColumn = column;
+			state.fallingTargetRow = Height - 1 - state.board.ColumnHeight(column);
+			state.fallingRow = -1;
+			state.fallStarted = now;
+			state.events |= piece == 1 ? EventPlayerMoved : EventCPUMoved;
+		}
+
+		inline void Land(GameState& state, std::chrono::nanoseconds now, const GameTiming& timing) noexcept
+		{
+			int column = state.fallingColumn;
+			bool winDetected = state.board.IsWinningMove(column);
+
+			state.board.Play(column);
+			state.record.moves[state.record.moveCount++] = (uint8_t)column;
+
+			if (winDetected)
+			{
+				state.phase = GamePhase::GameOver;
+				state.record.result = state.board.MoveCount() % 2 == 1 ? GameResult::FirstPlayerWin : GameResult::SecondPlayerWin;
+				state.events |= EventGameFinished;
+
+				//only lines through the stone just played can be complete
+				int landingCell = CellIndex(column, state.board.ColumnHeight(column) - 1);
+				state.winningPieces = WinningLinesThrough(state.board.OpponentStones(), landingCell);
+
+				state.gameOverUntil = now + timing.gameOverDuration;
+
+				if (state.fallingPiece == 1)
+					state.playerScore++;
+				else
+					state.cpuScore++;
+			}
+			else if (state.board.IsFull())
+			{
+				//draw, nobody scores
+				state.phase = GamePhase::GameOver;
+				state.record.result = GameResult::Draw;
+				state.events |= EventGameFinished;
+
+				state.gameOverUntil = now + timing.gameOverDuration;
+			}
+			else
+			{
+				state.phase = state.fallingPiece == 1 ? GamePhase::CPUTurn : GamePhase::PlayerTurn;
+			}
+
+			state.fallingPiece = 0;
+		}
+	}
+
+	[[nodiscard]]
+	inline GameState StepGame(GameState state, const GameInput& input, std::chrono::nanoseconds now, const GameTiming& timing = {}) noexcept
+	{
+		//a reported game has been dealt with by now
+		if (state.events & (EventGameFinished | EventGameLeft))
+			state.record = {};
+
+		state.events = 0;
+
+		if (input.escape)
+		{
+			//back to the menu, scores and all, keeping the moves for the caller to archive
+			GameRecord record = state.record;
+			record.result = GameResult::Unfinished;
+
+			state = {};
+			state.record = record;
+			state.events = EventGameLeft;
+			return state;
+		}
+
+		switch (state.phase)
+		{
+		case GamePhase::Menu:
+			if (input.click && input.button == MenuButton::Play)
+				state.phase = GamePhase::PlayerTurn;
+			else if (input.click && input.button == MenuButton::Exit)
+				state.events |= EventExit;
+			break;
+		case GamePhase::PlayerTurn:
+			if (input.click && input.column >= 0 && input.column < Width && state.board.CanPlay(input.column))
+				Detail::StartFalling(state, input.column, 1, now);
+			break;
+		case GamePhase::CPUTurn:
+			if (input.cpuColumn >= 0 && input.cpuColumn < Width && state.board.CanPlay(input.cpuColumn))
+				Detail::StartFalling(state, input.cpuColumn, 2, now);
+			break;
+		case GamePhase::PieceFalling:
+			state.fallingRow = std::chrono::duration<float>(now - state.fallStarted).count() * timing.fallRowsPerSecond - 1;
+
+			if (state.fallingRow > state.fallingTargetRow)
+				Detail::Land(state, now, timing);
+			break;
+		case GamePhase::GameOver:
+			state.highlightWinningPieces = (state.gameOverUntil - now) % timing.blinkPeriod < timing.blinkPeriod / 2;
+
+			if (state.gameOverUntil < now)
+			{
+				state.phase = GamePhase::PlayerTurn;
+				state.board = {};
+				state.winningPieces = 0;
+				state.highlightWinningPieces = false;
+			}
+			break;
+		}
+
+		return state;
+	}
+
+	//when the state next changes with no input: at once on the CPU's turn and while a piece
+	//falls, at the next blink or the end of a finished game, nanoseconds::max() when it waits
+	//for input
+	[[nodiscard]]
+	inline std::chrono::nanoseconds NextGameChange(const GameState& state, std::chrono::nanoseconds now, const GameTiming& timing = {}) noexcept
+	{
+		switch (state.phase)
+		{
+		case GamePhase::CPUTurn:
+		case GamePhase::PieceFalling:
+			return now;
+		case GamePhase::GameOver:
+		{
+			std::chrono::nanoseconds remaining = state.gameOverUntil - now;
+
+			if (remaining < std::chrono::nanoseconds::zero())
+				return now;
+
+			//lit while remaining % blinkPeriod is under half the period
+			std::chrono::nanoseconds phase = remaining % timing.blinkPeriod;
+			std::chrono::nanoseconds untilFlip = phase >= timing.blinkPeriod / 2 ? phase - timing.blinkPeriod / 2 : phase;
+
+			return now + (untilFlip < remaining ? untilFlip : remaining) + std::chrono::nanoseconds(1);
+		}
+		default:
+			return (std::chrono::nanoseconds::max)();
+		}
+	}
+}
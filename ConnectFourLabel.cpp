@@ -0,0 +1,445 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//bulk position labelling
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourLabel.cpp -o ConnectFourLabel
+//usage: ConnectFourLabel [-threads N] [-hash MB] [-book FILE] [-weak] [-checkpoint FILE] INPUT OUTPUT
+//
+//reads one position per line, a move string such as "4453", and writes the same line
+//followed by its score, or by win, draw or loss as 1, 0 or -1 with -weak. lines that are
+//not a position still in play get "?". output lines are in input order.
+//
+//positions are solved on all threads against one shared transposition table. only a
+//window of lines is in memory at any time, so the input can be any size. every few
+//seconds the output is flushed and the progress saved to the checkpoint file (OUTPUT.checkpoint
+//unless given); a job started again with the same files carries on from there, and the
+//checkpoint is removed once the whole input is done
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourSolver.h"
+
+using namespace ConnectFour;
+
+//lines in flight per thread. a slow position holds up the writing of everything after it
+//until the window is full, so the window has to be much larger than the thread count
+constexpr int WindowPerThread = 4096;
+
+constexpr auto CheckpointInterval = std::chrono::seconds(10);
+constexpr auto ProgressInterval = std::chrono::seconds(2);
+
+//longer lines can not be a position
+constexpr int MaxLineLength = 255;
+
+struct Slot
+{
+	char moves[MaxLineLength + 1];
+	//the rest of the line did not fit
+	bool truncated;
+	//the score, or the line is not a position when valid is false
+	int result;
+	bool valid;
+	bool done;
+};
+
+struct Checkpoint
+{
+	uint64_t lines;
+	uint64_t inputOffset;
+	uint64_t outputOffset;
+	bool weak;
+};
+
+[[nodiscard]]
+static bool SeekFile(FILE* file, uint64_t offset) noexcept
+{
+#ifdef _WIN32
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+[[nodiscard]]
+static bool ReadCheckpoint(const std::string& path, Checkpoint& checkpoint) noexcept
+{
+	FILE* file = fopen(path.c_str(), "r");
+
+	if (file == nullptr)
+		return false;
+
+	unsigned long long lines;
+	unsigned long long inputOffset;
+	unsigned long long outputOffset;
+	int weak;
+
+	bool read = fscanf(file, "C4LABEL 1 %llu %llu %llu %d", &lines, &inputOffset, &outputOffset, &weak) == 4;
+	fclose(file);
+
+	checkpoint = { .lines = lines, .inputOffset = inputOffset, .outputOffset = outputOffset, .weak = weak != 0 };
+	return read;
+}
+
+//written beside the old one and renamed over it, so a kill never leaves half a checkpoint
+[[nodiscard]]
+static bool WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint) noexcept
+{
+	std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+
+	if (file == nullptr)
+		return false;
+
+	bool written = fprintf(file, "C4LABEL 1 %llu %llu %llu %d\n",
+		(unsigned long long)checkpoint.lines,
+		(unsigned long long)checkpoint.inputOffset,
+		(unsigned long long)checkpoint.outputOffset,
+		checkpoint.weak ? 1 : 0) > 0;
+
+	if (fclose(file) != 0 || !written)
+		return false;
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+//the moves of a line without surrounding whitespace, false if it is not a position still in play
+[[nodiscard]]
+static bool ParseLine(char* line, Position& position) noexcept
+{
+	size_t length = strlen(line);
+
+	while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t'))
+		line[--length] = '\0';
+
+	position = {};
+	return PlayMoves(position, line);
+}
+
+int main(int argc, char** argv)
+{
+	int threadCount = (int)std::thread::hardware_concurrency();
+	size_t hashMegabytes = 1024;
+	const char* bookPath = nullptr;
+	bool weak = false;
+	const char* inputPath = nullptr;
+	const char* outputPath = nullptr;
+	std::string checkpointPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-book") == 0 && i + 1 < argc)
+			bookPath = argv[++i];
+		else if (strcmp(argv[i], "-weak") == 0)
+			weak = true;
+		else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc)
+			checkpointPath = argv[++i];
+		else if (argv[i][0] != '-' && inputPath == nullptr)
+			inputPath = argv[i];
+		else if (argv[i][0] != '-' && outputPath == nullptr)
+			outputPath = argv[i];
+		else
+		{
+			outputPath = nullptr;
+			break;
+		}
+	}
+
+	if (inputPath == nullptr || outputPath == nullptr)
+	{
+		fprintf(stderr, "usage: %s [-threads N] [-hash MB] [-book FILE] [-weak] [-checkpoint FILE] INPUT OUTPUT\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	if (checkpointPath.empty())
+		checkpointPath = std::string(outputPath) + ".checkpoint";
+
+	OpeningBook book;
+
+	if (bookPath != nullptr && !book.Open(bookPath))
+	{
+		fprintf(stderr, "unable to open book %s\n", bookPath);
+		return EXIT_FAILURE;
+	}
+
+	FILE* input = fopen(inputPath, "rb");
+
+	if (input == nullptr)
+	{
+		fprintf(stderr, "unable to open %s\n", inputPath);
+		return EXIT_FAILURE;
+	}
+
+	std::error_code sizeError;
+	uint64_t inputSize = std::filesystem::file_size(inputPath, sizeError);
+
+	Checkpoint checkpoint = { .lines = 0, .inputOffset = 0, .outputOffset = 0, .weak = weak };
+	FILE* output;
+
+	if (ReadCheckpoint(checkpointPath, checkpoint))
+	{
+		if (checkpoint.weak != weak)
+		{
+			fprintf(stderr, "%s was written %s -weak, run with the same options or remove it\n", checkpointPath.c_str(), checkpoint.weak ? "with" : "without");
+			return EXIT_FAILURE;
+		}
+
+		//anything written after the checkpoint is written again
+		std::error_code error;
+		std::filesystem::resize_file(outputPath, checkpoint.outputOffset, error);
+
+		if (error || !SeekFile(input, checkpoint.inputOffset))
+		{
+			fprintf(stderr, "unable to resume from %s\n", checkpointPath.c_str());
+			return EXIT_FAILURE;
+		}
+
+		output = fopen(outputPath, "ab");
+		fprintf(stderr, "resuming after %llu positions\n", (unsigned long long)checkpoint.lines);
+	}
+	else
+	{
+		output = fopen(outputPath, "wb");
+	}
+
+	if (output == nullptr)
+	{
+		fprintf(stderr, "unable to open %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	TranspositionTable table(hashMegabytes << 20, true);
+
+	//lines move through the window in order: read, claimed by a worker, done, written.
+	//a slot is only reused once the line in it has been written
+	const uint64_t windowSize = (uint64_t)WindowPerThread * threadCount;
+	std::vector<Slot> window(windowSize);
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable lineDone;
+
+	uint64_t readCount = 0;
+	uint64_t claimCount = 0;
+	uint64_t writeCount = 0;
+	bool inputFinished = false;
+
+	auto worker = [&]()
+	{
+		Solver solver(table);
+		solver.UseBook(&book);
+
+		while (true)
+		{
+			uint64_t index;
+
+			{
+				std::unique_lock lock(mutex);
+				workAvailable.wait(lock, [&] { return claimCount < readCount || inputFinished; });
+
+				if (claimCount == readCount)
+					return;
+
+				index = claimCount++;
+			}
+
+			//no other thread touches a claimed slot until it is done
+			Slot& slot = window[index % windowSize];
+			Position position;
+
+			slot.valid = !slot.truncated && ParseLine(slot.moves, position);
+
+			if (slot.valid)
+				slot.result = weak ? solver.SolveWeak(position) : solver.Solve(position);
+
+			{
+				std::lock_guard lock(mutex);
+				slot.done = true;
+			}
+
+			lineDone.notify_one();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threadCount; i++)
+		workers.emplace_back(worker);
+
+	auto start = std::chrono::steady_clock::now();
+	auto lastCheckpoint = start;
+	auto lastProgress = start;
+
+	uint64_t inputOffset = checkpoint.inputOffset;
+	uint64_t outputOffset = checkpoint.outputOffset;
+	//input offset after each line in the window, what a checkpoint has to record
+	std::vector<uint64_t> lineEnds(windowSize);
+	uint64_t writtenInputOffset = inputOffset;
+
+	bool failed = false;
+	char line[MaxLineLength + 2];
+
+	while (true)
+	{
+		//top up the window, workers never look at slots past readCount
+		uint64_t newCount = readCount;
+
+		while (!inputFinished && newCount < writeCount + windowSize)
+		{
+			if (fgets(line, sizeof(line), input) == nullptr)
+			{
+				std::lock_guard lock(mutex);
+				inputFinished = true;
+				break;
+			}
+
+			size_t length = strlen(line);
+			inputOffset += length;
+
+			Slot& slot = window[newCount % windowSize];
+
+			//too long to be a position, skip the rest of it and keep the start for the output
+			slot.truncated = length == sizeof(line) - 1 && line[length - 1] != '\n';
+
+			if (slot.truncated)
+			{
+				int next;
+				while ((next = fgetc(input)) != EOF && next != '\n')
+					inputOffset++;
+
+				if (next == '\n')
+					inputOffset++;
+			}
+
+			memcpy(slot.moves, line, MaxLineLength + 1);
+			slot.moves[MaxLineLength] = '\0';
+			slot.done = false;
+
+			lineEnds[newCount % windowSize] = inputOffset;
+			newCount++;
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			readCount = newCount;
+		}
+
+		workAvailable.notify_all();
+
+		//write out every finished line at the front of the window
+		uint64_t ready;
+
+		{
+			std::unique_lock lock(mutex);
+
+			lineDone.wait_for(lock, std::chrono::milliseconds(100), [&]
+			{
+				return (writeCount < readCount && window[writeCount % windowSize].done) || (inputFinished && writeCount == readCount);
+			});
+
+			ready = writeCount;
+			while (ready < readCount && window[ready % windowSize].done)
+				ready++;
+		}
+
+		for (; writeCount < ready; writeCount++)
+		{
+			const Slot& slot = window[writeCount % windowSize];
+			int written;
+
+			if (slot.valid)
+				written = fprintf(output, "%s %d\n", slot.moves, slot.result);
+			else
+				written = fprintf(output, "%s ?\n", slot.moves);
+
+			if (written < 0)
+				failed = true;
+
+			outputOffset += written < 0 ? 0 : written;
+			writtenInputOffset = lineEnds[writeCount % windowSize];
+		}
+
+		if (failed)
+		{
+			fprintf(stderr, "unable to write %s\n", outputPath);
+			break;
+		}
+
+		bool finished = inputFinished && writeCount == readCount;
+		auto now = std::chrono::steady_clock::now();
+
+		if (now - lastCheckpoint >= CheckpointInterval && !finished)
+		{
+			Checkpoint progress = { .lines = checkpoint.lines + writeCount, .inputOffset = writtenInputOffset, .outputOffset = outputOffset, .weak = weak };
+
+			if (fflush(output) != 0 || !WriteCheckpoint(checkpointPath, progress))
+				fprintf(stderr, "unable to write %s\n", checkpointPath.c_str());
+
+			lastCheckpoint = now;
+		}
+
+		if (now - lastProgress >= ProgressInterval || finished)
+		{
+			double seconds = std::chrono::duration<double>(now - start).count();
+			double rate = writeCount / seconds;
+
+			//the share of the input read so far, by bytes, stands in for the share of lines
+			double doneShare = inputSize > 0 ? (double)writtenInputOffset / inputSize : 0;
+			double startShare = inputSize > 0 ? (double)checkpoint.inputOffset / inputSize : 0;
+			double eta = doneShare > startShare ? seconds * (1 - doneShare) / (doneShare - startShare) : 0;
+
+			fprintf(stderr, "%llu positions, %.1f/s, %.1f%%, eta %.0f s\n",
+				(unsigned long long)(checkpoint.lines + writeCount), rate, doneShare * 100, eta);
+
+			lastProgress = now;
+		}
+
+		if (finished)
+			break;
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		inputFinished = true;
+		//a failed write leaves the workers nothing more to claim
+		readCount = claimCount;
+	}
+
+	workAvailable.notify_all();
+
+	for (std::thread& thread : workers)
+		thread.join();
+
+	fclose(input);
+
+	if (fclose(output) != 0 || failed)
+	{
+		fprintf(stderr, "unable to write %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	std::error_code error;
+	std::filesystem::remove(checkpointPath, error);
+
+	return EXIT_SUCCESS;
+}
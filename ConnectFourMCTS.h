@@ -0,0 +1,510 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourCore.h"
+
+//monte carlo tree search, an engine that needs no solver and no table
+//
+//every playout walks the tree by UCT, adds the children of the leaf it reaches and plays
+//the game out with RolloutMove(). the move played is the one visited most
+//
+//the tree lives in one node pool allocated before the search, children of a node are
+//next to each other and found by index. threads share the tree: a thread going down adds
+//a visit to every node on its way with no result yet, a virtual loss that steers the
+//others elsewhere until its result comes back up. a node being expanded by one thread is
+//played out from by the others, and once the pool is full leaves stop being expanded.
+//
+//the calling thread always searches, helpers start with the first search and sleep on a
+//condition variable between searches, like ParallelSolver's
+
+namespace ConnectFour
+{
+	//one of the given moves, each as likely as the others. moves must not be empty
+	template<typename Rng>
+	[[nodiscard]]
+	int PickMove(Bitboard moves, Rng& rng) noexcept
+	{
+		int pick = (int)(rng() % (uint64_t)std::popcount(moves));
+
+		for (int x = 0; x < Width; x++)
+		{
+			if ((moves & ColumnMask(x)) && pick-- == 0)
+				return x;
+		}
+
+		return -1;
+	}
+
+	//any playable column, the game's original CPU player. the board must not be full
+	template<typename Rng>
+	[[nodiscard]]
+	int RandomMove(const Position& position, Rng& rng) noexcept
+	{
+		return PickMove(position.PossibleMoves(), rng);
+	}
+
+	//the playout policy: wins when it can, otherwise a random move that does not hand the
+	//opponent a win, otherwise any random move. the board must not be full
+	template<typename Rng>
+	[[nodiscard]]
+	int RolloutMove(const Position& position, Rng& rng) noexcept
+	{
+		Bitboard moves = position.PossibleMoves();
+
+		if (position.CanWinNext())
+			moves &= WinningSpots(position.CurrentStones(), position.Occupied());
+		else if (position.PossibleNonLosingMoves() != 0)
+			moves = position.PossibleNonLosingMoves();
+
+		return PickMove(moves, rng);
+	}
+
+	//splitmix64, plenty for playouts and a fraction of the cost of std::mt19937_64
+	class PlayoutRandom
+	{
+	public:
+		explicit PlayoutRandom(uint64_t seed) noexcept :
+			state(seed)
+		{
+		}
+
+		uint64_t operator()() noexcept
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+	private:
+		uint64_t state;
+	};
+
+	//max is parenthesized against Windows.h's max macro
+	struct MCTSLimits
+	{
+		std::chrono::steady_clock::time_point deadline = (std::chrono::steady_clock::time_point::max)();
+		uint64_t playouts = UINT64_MAX;
+	};
+
+	struct MCTSResult
+	{
+		int column;
+		//share of the playouts through the move won by the side to move, draws counting half
+		float value;
+		uint64_t playouts;
+		size_t nodes;
+		double seconds;
+	};
+
+	class MCTS
+	{
+	public:
+		//16 bytes a node, 16 MB
+		static constexpr size_t DefaultNodeCapacity = 1 << 20;
+
+		explicit MCTS(uint64_t seed = 1, int threadCount = 1, size_t nodeCapacity = DefaultNodeCapacity) noexcept :
+			seed(seed),
+			threadCount(threadCount < 1 ? 1 : threadCount),
+			nodeCapacity(nodeCapacity < Width + 1 ? Width + 1 : nodeCapacity)
+		{
+		}
+
+		~MCTS()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quitting = true;
+			}
+
+			wake.notify_all();
+
+			for (std::thread& helper : helpers)
+				helper.join();
+		}
+
+		//the helpers point back at this object
+		MCTS(const MCTS&) = delete;
+		MCTS& operator=(const MCTS&) = delete;
+
+		//column after the given number of playouts, -1 when the board is full
+		[[nodiscard]]
+		int BestMove(const Position& position, int playouts)
+		{
+			return Search(position, { .playouts = (uint64_t)(playouts < 1 ? 1 : playouts) }).column;
+		}
+
+		//searches until either limit is reached but always plays at least one playout, column
+		//is -1 when the board is full
+		[[nodiscard]]
+		MCTSResult Search(const Position& position, const MCTSLimits& limits)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			if (position.IsFull())
+				return { .column = -1, .value = 0.5f, .playouts = 0, .nodes = 0, .seconds = 0 };
+
+			//no point searching for a move the rollout policy already finds
+			if (position.CanWinNext())
+			{
+				PlayoutRandom rng(seed++);
+				return { .column = RolloutMove(position, rng), .value = 1, .playouts = 0, .nodes = 0, .seconds = 0 };
+			}
+
+			//a playout adds at most Width nodes, so a small budget needs a small pool. the
+			//pool only ever grows here, never while searching
+			uint64_t playouts = limits.playouts < 1 ? 1 : limits.playouts;
+			size_t needed = playouts < nodeCapacity / Width ? (size_t)playouts * Width + 1 : nodeCapacity;
+
+			if (poolSize < needed)
+			{
+				nodes = std::make_unique<Node[]>(needed);
+				poolSize = needed;
+			}
+
+			InitializeNode(nodes[0], -1, false, 0);
+			nodeCount.store(1, std::memory_order_relaxed);
+			playoutCount.store(0, std::memory_order_relaxed);
+			stop.store(false, std::memory_order_relaxed);
+
+			if (helpers.empty() && threadCount > 1)
+				StartHelpers();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				searchPosition = &position;
+				searchLimits = &limits;
+
+				busyHelpers = threadCount - 1;
+				generation++;
+			}
+
+			wake.notify_all();
+
+			Worker(position, limits, seed);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				helpersDone.wait(lock, [this] { return busyHelpers == 0; });
+			}
+
+			//a different sequence next time
+			seed += threadCount;
+
+			const Node& root = nodes[0];
+
+			int best = -1;
+			uint32_t bestVisits = 0;
+
+			for (int i = 0; i < root.childCount.load(std::memory_order_relaxed); i++)
+			{
+				const Node& child = nodes[root.firstChild + i];
+				uint32_t visits = child.visits.load(std::memory_order_relaxed);
+
+				if (best < 0 || visits > bestVisits)
+				{
+					best = (int)root.firstChild + i;
+					bestVisits = visits;
+				}
+			}
+
+			MCTSResult result = {
+				.column = nodes[best].column,
+				.value = bestVisits > 0 ? nodes[best].score.load(std::memory_order_relaxed) / (2.f * bestVisits) : 0.5f,
+				.playouts = playoutCount.load(std::memory_order_relaxed),
+				.nodes = NodeCount(),
+				.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+			};
+
+			return result;
+		}
+
+		//nodes in the tree of the last search
+		[[nodiscard]]
+		size_t NodeCount() const noexcept
+		{
+			size_t count = nodeCount.load(std::memory_order_relaxed);
+			return count < poolSize ? count : poolSize;
+		}
+
+	private:
+		static constexpr int8_t Unexpanded = -1;
+		static constexpr int8_t Expanding = -2;
+
+		//results are counted in half points, 2 for a win, 1 for a draw
+		static constexpr uint32_t WinScore = 2;
+
+		//from the point of view of the player whose move led to the node
+		struct Node
+		{
+			//playouts through the node, including those still on their way down
+			std::atomic<uint32_t> visits;
+			std::atomic<uint32_t> score;
+			uint32_t firstChild;
+			//Unexpanded, Expanding, or the number of children once they can be read
+			std::atomic<int8_t> childCount;
+			int8_t column;
+			bool terminal;
+			//the score of every playout that reaches a terminal node
+			uint8_t terminalScore;
+		};
+
+		static_assert(sizeof(Node) == 16);
+
+		//sqrt(2), the textbook UCT constant for results between 0 and 1
+		static constexpr float Exploration = 1.41421356f;
+
+		//playouts between looks at the clock
+		static constexpr uint64_t DeadlineInterval = 64;
+
+		static void InitializeNode(Node& node, int column, bool terminal, uint8_t terminalScore) noexcept
+		{
+			node.visits.store(0, std::memory_order_relaxed);
+			node.score.store(0, std::memory_order_relaxed);
+			node.firstChild = 0;
+			node.childCount.store(Unexpanded, std::memory_order_relaxed);
+			node.column = (int8_t)column;
+			node.terminal = terminal;
+			node.terminalScore = terminalScore;
+		}
+
+		void StartHelpers()
+		{
+			helpers.reserve(threadCount - 1);
+
+			for (int i = 1; i < threadCount; i++)
+				helpers.emplace_back(&MCTS::HelperLoop, this, i);
+		}
+
+		//sleeps until Search() hands out a new search or the MCTS is destroyed
+		void HelperLoop(int index) noexcept
+		{
+			uint64_t lastGeneration = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&] { return quitting || generation != lastGeneration; });
+
+					if (quitting)
+						return;
+
+					lastGeneration = generation;
+				}
+
+				Worker(*searchPosition, *searchLimits, seed + index);
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					busyHelpers--;
+				}
+
+				helpersDone.notify_one();
+			}
+		}
+
+		void Worker(const Position& root, const MCTSLimits& limits, uint64_t threadSeed) noexcept
+		{
+			PlayoutRandom rng(threadSeed);
+
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				uint64_t playout = playoutCount.fetch_add(1, std::memory_order_relaxed);
+
+				//the first playout is always played, it expands the root so there is a move
+				//to return even when the deadline has already passed
+				if (playout != 0 && (playout >= limits.playouts ||
+					(playout % DeadlineInterval == 0 && std::chrono::steady_clock::now() >= limits.deadline)))
+				{
+					playoutCount.fetch_sub(1, std::memory_order_relaxed);
+					stop.store(true, std::memory_order_relaxed);
+					break;
+				}
+
+				Playout(root, rng);
+			}
+		}
+
+		void Playout(const Position& root, PlayoutRandom& rng) noexcept
+		{
+			uint32_t path[CellCount + 1];
+			int depth = 0;
+
+			Position position = root;
+			uint32_t index = 0;
+
+			path[0] = 0;
+			nodes[0].visits.fetch_add(1, std::memory_order_relaxed);
+
+			uint32_t score;
+
+			while (true)
+			{
+				Node& node = nodes[index];
+
+				if (node.terminal)
+				{
+					score = node.terminalScore;
+					break;
+				}
+
+				int8_t childCount = node.childCount.load(std::memory_order_acquire);
+				bool expanded = false;
+
+				if (childCount == Unexpanded &&
+					node.childCount.compare_exchange_strong(childCount, Expanding, std::memory_order_relaxed))
+				{
+					childCount = Expand(node, position);
+					expanded = childCount > 0;
+				}
+
+				//someone else is expanding it, or the pool is full
+				if (childCount <= 0)
+				{
+					score = WinScore - Rollout(position, rng);
+					break;
+				}
+
+				index = SelectChild(node, childCount);
+				nodes[index].visits.fetch_add(1, std::memory_order_relaxed);
+				position.Play(nodes[index].column);
+				path[++depth] = index;
+
+				//one new node per playout, played out from there
+				if (expanded)
+				{
+					const Node& child = nodes[index];
+					score = child.terminal ? child.terminalScore : WinScore - Rollout(position, rng);
+					break;
+				}
+			}
+
+			for (; depth >= 0; depth--)
+			{
+				nodes[path[depth]].score.fetch_add(score, std::memory_order_relaxed);
+				score = WinScore - score;
+			}
+		}
+
+		[[nodiscard]]
+		uint32_t SelectChild(const Node& node, int childCount) const noexcept
+		{
+			float logVisits = std::log((float)node.visits.load(std::memory_order_relaxed));
+
+			uint32_t best = node.firstChild;
+			float bestScore = -1;
+
+			for (uint32_t i = node.firstChild; i < node.firstChild + childCount; i++)
+			{
+				const Node& child = nodes[i];
+				uint32_t visits = child.visits.load(std::memory_order_relaxed);
+
+				if (visits == 0)
+					return i;
+
+				float score = child.score.load(std::memory_order_relaxed) / (2.f * visits) + Exploration * std::sqrt(logVisits / visits);
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = i;
+				}
+			}
+
+			return best;
+		}
+
+		//the node is marked Expanding and its position is not over. publishes and returns
+		//the number of children, or puts the node back and returns 0 if the pool is full
+		[[nodiscard]]
+		int8_t Expand(Node& node, const Position& position) noexcept
+		{
+			int8_t childCount = (int8_t)std::popcount(position.PossibleMoves());
+			size_t firstChild = nodeCount.fetch_add(childCount, std::memory_order_relaxed);
+
+			if (firstChild + childCount > poolSize)
+			{
+				node.childCount.store(Unexpanded, std::memory_order_relaxed);
+				return 0;
+			}
+
+			uint32_t child = (uint32_t)firstChild;
+
+			for (int x = 0; x < Width; x++)
+			{
+				if (!position.CanPlay(x))
+					continue;
+
+				if (position.IsWinningMove(x))
+					InitializeNode(nodes[child], x, true, WinScore);
+				else if (position.MoveCount() + 1 == CellCount)
+					InitializeNode(nodes[child], x, true, WinScore / 2);
+				else
+					InitializeNode(nodes[child], x, false, 0);
+
+				child++;
+			}
+
+			node.firstChild = (uint32_t)firstChild;
+			node.childCount.store(childCount, std::memory_order_release);
+			return childCount;
+		}
+
+		//plays the game out, WinScore if the side to move wins, half of it for a draw
+		[[nodiscard]]
+		static uint32_t Rollout(Position position, PlayoutRandom& rng) noexcept
+		{
+			for (int ply = 0;; ply++)
+			{
+				if (position.IsFull())
+					return WinScore / 2;
+
+				if (position.CanWinNext())
+					return ply % 2 == 0 ? WinScore : 0;
+
+				position.Play(RolloutMove(position, rng));
+			}
+		}
+
+		uint64_t seed;
+		int threadCount;
+		size_t nodeCapacity;
+
+		std::unique_ptr<Node[]> nodes;
+		size_t poolSize = 0;
+
+		std::atomic<size_t> nodeCount = 0;
+		std::atomic<uint64_t> playoutCount = 0;
+		std::atomic<bool> stop = false;
+
+		std::vector<std::thread> helpers;
+
+		//the search being run, generation counts the searches handed out
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable helpersDone;
+		const Position* searchPosition = nullptr;
+		const MCTSLimits* searchLimits = nullptr;
+		uint64_t generation = 0;
+		int busyHelpers = 0;
+		bool quitting = false;
+	};
+}
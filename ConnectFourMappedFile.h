@@ -0,0 +1,140 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//read only view of a whole file, shared by the opening book and the game archive
+
+namespace ConnectFour
+{
+	class MappedFile
+	{
+	public:
+		//how the file will be read, passed on to the kernel's read ahead
+		enum class Access
+		{
+			Random,
+			Sequential
+		};
+
+		MappedFile() noexcept = default;
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		//false if the file is missing or empty
+		[[nodiscard]]
+		bool Open(const char* path, Access access) noexcept
+		{
+			Close();
+
+#ifdef _WIN32
+			(void)access;
+
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size;
+
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return false;
+			}
+
+			HANDLE fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+
+			if (fileMapping == nullptr)
+				return false;
+
+			mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(fileMapping);
+
+			if (mapping == nullptr)
+				return false;
+
+			mappingSize = (size_t)size.QuadPart;
+			return true;
+#else
+			int file = open(path, O_RDONLY);
+
+			if (file < 0)
+				return false;
+
+			struct stat status;
+
+			if (fstat(file, &status) != 0 || status.st_size == 0)
+			{
+				close(file);
+				return false;
+			}
+
+			void* memory = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+			close(file);
+
+			if (memory == MAP_FAILED)
+				return false;
+
+			madvise(memory, (size_t)status.st_size, access == Access::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+			mapping = memory;
+			mappingSize = (size_t)status.st_size;
+			return true;
+#endif
+		}
+
+		void Close() noexcept
+		{
+			if (mapping == nullptr)
+				return;
+
+#ifdef _WIN32
+			UnmapViewOfFile(mapping);
+#else
+			munmap((void*)mapping, mappingSize);
+#endif
+
+			mapping = nullptr;
+			mappingSize = 0;
+		}
+
+		[[nodiscard]]
+		const uint8_t* Data() const noexcept
+		{
+			return (const uint8_t*)mapping;
+		}
+
+		[[nodiscard]]
+		size_t Size() const noexcept
+		{
+			return mappingSize;
+		}
+
+	private:
+		const void* mapping = nullptr;
+		size_t mappingSize = 0;
+	};
+}
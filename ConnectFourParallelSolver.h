@@ -0,0 +1,328 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ConnectFourSolver.h"
+
+//lazy SMP: every thread solves the same position against one shared transposition table.
+//helpers search in slightly different orders so they fill the table with results the
+//others can pick up, and whichever thread finishes first provides the answer and stops
+//the rest. the calling thread always takes part, so one thread means no helpers at all.
+//
+//the solvers and the helper threads are made once and kept: helpers start with the first
+//search and sleep on a condition variable between searches, so a search costs a wake up
+//rather than starting threads, and the solvers keep their history and killers from one
+//search to the next
+
+namespace ConnectFour
+{
+	class ParallelSolver
+	{
+	public:
+		ParallelSolver(TranspositionTable& table, int threadCount, bool pinThreads = false) noexcept :
+			threadCount(threadCount < 1 ? 1 : threadCount),
+			pinThreads(pinThreads)
+		{
+			solvers.reserve(this->threadCount);
+
+			for (int i = 0; i < this->threadCount; i++)
+				solvers.emplace_back(table, i, &stop);
+		}
+
+		~ParallelSolver()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quitting = true;
+			}
+
+			wake.notify_all();
+
+			for (std::thread& helper : helpers)
+				helper.join();
+		}
+
+		//the helpers and solvers point back at this object
+		ParallelSolver(const ParallelSolver&) = delete;
+		ParallelSolver& operator=(const ParallelSolver&) = delete;
+
+		void UseBook(const OpeningBook* openingBook) noexcept
+		{
+			for (Solver& solver : solvers)
+				solver.UseBook(openingBook);
+		}
+
+		//for Search(), see Solver::UseEvaluation()
+		void UseEvaluation(const EvalWeights* weights) noexcept
+		{
+			for (Solver& solver : solvers)
+				solver.UseEvaluation(weights);
+		}
+
+		[[nodiscard]]
+		int Solve(const Position& position) noexcept
+		{
+			std::vector<int> scores(threadCount);
+
+			int winner = Run([&](Solver& solver, int index)
+			{
+				scores[index] = solver.Solve(position);
+				return !solver.Stopped();
+			});
+
+			return scores[winner];
+		}
+
+		[[nodiscard]]
+		int SolveNullWindow(const Position& position) noexcept
+		{
+			std::vector<int> scores(threadCount);
+
+			int winner = Run([&](Solver& solver, int index)
+			{
+				scores[index] = solver.SolveNullWindow(position);
+				return !solver.Stopped();
+			});
+
+			return scores[winner];
+		}
+
+		[[nodiscard]]
+		int SolveWeak(const Position& position) noexcept
+		{
+			std::vector<int> results(threadCount);
+
+			int winner = Run([&](Solver& solver, int index)
+			{
+				results[index] = solver.SolveWeak(position);
+				return !solver.Stopped();
+			});
+
+			return results[winner];
+		}
+
+		[[nodiscard]]
+		int BestMove(const Position& position, int* scoreOut = nullptr) noexcept
+		{
+			std::vector<int> columns(threadCount);
+			std::vector<int> scores(threadCount);
+
+			int winner = Run([&](Solver& solver, int index)
+			{
+				columns[index] = solver.BestMove(position, &scores[index]);
+				return !solver.Stopped();
+			});
+
+			if (scoreOut)
+				*scoreOut = scores[winner];
+
+			return columns[winner];
+		}
+
+		//every thread deepens on its own, the first one to finish stops the rest and the
+		//deepest completed iteration wins. the node budget is split between the threads
+		[[nodiscard]]
+		SearchResult Search(const Position& position, const SearchLimits& limits) noexcept
+		{
+			std::vector<SearchResult> results(threadCount);
+
+			SearchLimits threadLimits = limits;
+			threadLimits.nodeBudget = limits.nodeBudget / threadCount;
+
+			//a stopped thread still returns its last completed iteration
+			(void)Run([&](Solver& solver, int index)
+			{
+				results[index] = solver.Search(position, threadLimits);
+				return true;
+			});
+
+			SearchResult best = results[0];
+
+			for (const SearchResult& result : results)
+			{
+				if (result.exact > best.exact || (result.exact == best.exact && result.depth > best.depth))
+					best = result;
+			}
+
+			return best;
+		}
+
+		//summed over every thread of the last search
+		[[nodiscard]]
+		uint64_t NodeCount() const noexcept
+		{
+			return nodeCount;
+		}
+
+		[[nodiscard]]
+		const TableStats& TableStatistics() const noexcept
+		{
+			return tableStats;
+		}
+
+		[[nodiscard]]
+		int ThreadCount() const noexcept
+		{
+			return threadCount;
+		}
+
+	private:
+		//work(solver, index) returns true when its thread finished rather than being stopped.
+		//returns the index of the first thread that finished
+		template<typename Work>
+		int Run(const Work& work) noexcept
+		{
+			stop.store(false, std::memory_order_relaxed);
+			winner.store(-1, std::memory_order_relaxed);
+
+			for (Solver& solver : solvers)
+				solver.ResetNodeCount();
+
+			if (helpers.empty() && threadCount > 1)
+				StartHelpers();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				job = [](const void* context, Solver& solver, int index)
+				{
+					return (*(const Work*)context)(solver, index);
+				};
+				jobContext = &work;
+
+				busyHelpers = threadCount - 1;
+				generation++;
+			}
+
+			wake.notify_all();
+
+			RunJob(0);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				helpersDone.wait(lock, [this] { return busyHelpers == 0; });
+			}
+
+			nodeCount = 0;
+			tableStats = {};
+
+			for (const Solver& solver : solvers)
+			{
+				nodeCount += solver.NodeCount();
+				tableStats += solver.TableStatistics();
+			}
+
+			//the calling thread only stops once another thread has finished
+			return winner.load(std::memory_order_relaxed);
+		}
+
+		//runs the current job on solvers[index], the first to finish stops the others
+		void RunJob(int index) noexcept
+		{
+			if (!job(jobContext, solvers[index], index))
+				return;
+
+			int expected = -1;
+			winner.compare_exchange_strong(expected, index);
+			stop.store(true, std::memory_order_relaxed);
+		}
+
+		void StartHelpers() noexcept
+		{
+			helpers.reserve(threadCount - 1);
+
+			for (int i = 1; i < threadCount; i++)
+			{
+				helpers.emplace_back(&ParallelSolver::HelperLoop, this, i);
+
+				if (pinThreads)
+					PinThread(helpers.back(), i);
+			}
+		}
+
+		//sleeps until Run() hands out a new job or the solver is destroyed
+		void HelperLoop(int index) noexcept
+		{
+			uint64_t lastGeneration = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&] { return quitting || generation != lastGeneration; });
+
+					if (quitting)
+						return;
+
+					lastGeneration = generation;
+				}
+
+				RunJob(index);
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					busyHelpers--;
+				}
+
+				helpersDone.notify_one();
+			}
+		}
+
+		static void PinThread(std::thread& thread, int index) noexcept
+		{
+			unsigned int cpuCount = std::thread::hardware_concurrency();
+
+			if (cpuCount == 0)
+				return;
+
+			unsigned int cpu = (unsigned int)index % cpuCount;
+
+#ifdef _WIN32
+			SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << cpu);
+#else
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+		}
+
+		int threadCount;
+		bool pinThreads;
+
+		//solvers[0] is the calling thread's, the others each belong to a helper
+		std::vector<Solver> solvers;
+		std::vector<std::thread> helpers;
+
+		std::atomic<bool> stop = false;
+		std::atomic<int> winner = -1;
+
+		//the job being run, generation counts the jobs handed out
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable helpersDone;
+		bool (*job)(const void* context, Solver& solver, int index) = nullptr;
+		const void* jobContext = nullptr;
+		uint64_t generation = 0;
+		int busyHelpers = 0;
+		bool quitting = false;
+
+		uint64_t nodeCount = 0;
+		TableStats tableStats = {};
+	};
+}
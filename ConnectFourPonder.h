@@ -0,0 +1,214 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ConnectFourSolver.h"
+
+//background search while the engine would otherwise sit idle
+//
+//Think() works out the engine's move for a position it is about to face, Ponder() guesses
+//the opponent's replies to a position and works out the engine's answer to each, most
+//likely reply first. everything lands in the shared transposition table, so even an
+//unfinished search speeds up the real one, and finished answers can be taken as is.
+//
+//the worker checks a stop flag at every node, so Stop() and starting new work only wait
+//for the current node to unwind. it is one thread started with the first work and kept
+//asleep between jobs, so pondering after every move starts no threads
+
+namespace ConnectFour
+{
+	class Ponderer
+	{
+	public:
+		explicit Ponderer(TranspositionTable& table) noexcept :
+			solver(table, 0, &stop)
+		{
+		}
+
+		~Ponderer()
+		{
+			Stop();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quitting = true;
+			}
+
+			wake.notify_one();
+
+			if (worker.joinable())
+				worker.join();
+		}
+
+		Ponderer(const Ponderer&) = delete;
+		Ponderer& operator=(const Ponderer&) = delete;
+
+		//only call between jobs, the worker reads it
+		void UseBook(const OpeningBook* openingBook) noexcept
+		{
+			Stop();
+			solver.UseBook(openingBook);
+		}
+
+		//position has the engine to move
+		void Think(const Position& position) noexcept
+		{
+			Stop();
+
+			targets[0] = { .position = position, .column = -1 };
+			targetCount = 1;
+
+			Launch();
+		}
+
+		//position has the opponent to move
+		void Ponder(const Position& position) noexcept
+		{
+			Stop();
+
+			targetCount = 0;
+
+			//a winning opponent leaves nothing to answer
+			if (position.CanWinNext())
+				return;
+
+			Bitboard replies = position.PossibleNonLosingMoves();
+
+			//every reply loses anyway, search them all
+			if (replies == 0)
+				replies = position.PossibleMoves();
+
+			for (int i = 0; i < Width; i++)
+			{
+				int column = ColumnOrder.columns[i];
+
+				if ((replies & ColumnMask(column)) == 0)
+					continue;
+
+				Position child = position;
+				child.Play(column);
+
+				if (child.IsFull())
+					continue;
+
+				targets[targetCount++] = { .position = child, .column = -1 };
+			}
+
+			Launch();
+		}
+
+		//returns once the worker is idle
+		void Stop() noexcept
+		{
+			stop.store(true, std::memory_order_relaxed);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [this] { return !busy; });
+		}
+
+		//stops the worker, true if it had already finished the engine's move for position
+		[[nodiscard]]
+		bool TakeResult(const Position& position, int& column) noexcept
+		{
+			Stop();
+
+			for (int i = 0; i < targetCount; i++)
+			{
+				if (targets[i].column >= 0 && targets[i].position.Key() == position.Key())
+				{
+					column = targets[i].column;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+	private:
+		struct Target
+		{
+			Position position;
+			int column;
+		};
+
+		//the worker is idle, so the targets are ours to hand over
+		void Launch() noexcept
+		{
+			if (targetCount == 0)
+				return;
+
+			if (!worker.joinable())
+				worker = std::thread(&Ponderer::WorkerLoop, this);
+
+			stop.store(false, std::memory_order_relaxed);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busy = true;
+				generation++;
+			}
+
+			wake.notify_one();
+		}
+
+		void WorkerLoop() noexcept
+		{
+			uint64_t lastGeneration = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&] { return quitting || generation != lastGeneration; });
+
+					if (quitting)
+						return;
+
+					lastGeneration = generation;
+				}
+
+				for (int i = 0; i < targetCount; i++)
+				{
+					int column = solver.BestMove(targets[i].position);
+
+					if (solver.Stopped())
+						break;
+
+					targets[i].column = column;
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					busy = false;
+				}
+
+				idle.notify_all();
+			}
+		}
+
+		Solver solver;
+
+		std::thread worker;
+		std::atomic<bool> stop = false;
+
+		//a job is handed out by bumping generation, busy until the worker is done with it
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		uint64_t generation = 0;
+		bool busy = false;
+		bool quitting = false;
+
+		Target targets[Width];
+		int targetCount = 0;
+	};
+}
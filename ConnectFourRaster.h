@@ -0,0 +1,585 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ConnectFourScene.h"
+
+//renders positions into images on the CPU, for thumbnails without a window or a GPU
+//
+//the layout is the game's own (SceneLayout), at any image size: the board with its holes
+//cut out, the pieces behind them and the winning line in the win colors. names and scores
+//are not drawn. the board is antialiased with 4x4 samples a pixel, so a pixel is one of 17
+//blends of the board with the background or with one of the four piece colors, and images
+//are kept as one palette index a pixel.
+//
+//everything a position can show is worked out when the rasterizer is made: the empty board,
+//and for every hole a tile of the pixels it covers in each piece color. a render is then one
+//copy of the empty board and a row copy per tile for each stone. a rasterizer is only read
+//after it is made, so any number of threads can render with one.
+//
+//ImageEncoder writes the results as PPM, or as palette PNG compressed with fixed Huffman
+//codes, which for images made of long runs of a few colors does nearly as well as zlib
+
+namespace ConnectFour
+{
+	class BoardRasterizer
+	{
+	public:
+		//the background or a piece color blended with the board, at 17 levels of coverage
+		static constexpr int CoverageLevels = 17;
+		static constexpr int PaletteSize = 5 * CoverageLevels;
+
+		BoardRasterizer(int width, int height) :
+			width(width),
+			height(height),
+			layout(SceneLayout::Compute(width, height))
+		{
+			//the background first, then the piece colors in the order tiles are kept
+			const SceneColor* fronts[5] = { &Black, &Color(SceneBrush::Player), &Color(SceneBrush::CPU), &Color(SceneBrush::PlayerWin), &Color(SceneBrush::CPUWin) };
+
+			for (int front = 0; front < 5; front++)
+			{
+				for (int cover = 0; cover < CoverageLevels; cover++)
+					Blend(&palette[(front * CoverageLevels + cover) * 3], *fronts[front], Color(SceneBrush::Board), cover);
+			}
+
+			background.resize((size_t)width * height);
+
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+					background[(size_t)y * width + x] = BoardCoverage(x, y);
+			}
+
+			for (int x = 0; x < Width; x++)
+			{
+				for (int y = 0; y < Height; y++)
+				{
+					Tile& tile = tiles[x * Height + y];
+
+					//the hole's bounding pixels, every other pixel of the cell is board
+					ScenePoint center = layout.CellCenter(x, y);
+					float radius = layout.holeRadius;
+
+					tile.left = Clamp((int)std::floor(center.x - radius), width);
+					tile.top = Clamp((int)std::floor(center.y - radius), height);
+					tile.width = Clamp((int)std::ceil(center.x + radius), width) - tile.left;
+					tile.height = Clamp((int)std::ceil(center.y + radius), height) - tile.top;
+					tile.offset = tilePixels.size();
+
+					for (int front = 1; front < 5; front++)
+					{
+						for (int row = 0; row < tile.height; row++)
+						{
+							for (int column = 0; column < tile.width; column++)
+							{
+								uint8_t cover = background[(size_t)(tile.top + row) * width + tile.left + column];
+								tilePixels.push_back((uint8_t)(front * CoverageLevels + cover));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		[[nodiscard]]
+		int ImageWidth() const noexcept
+		{
+			return width;
+		}
+
+		[[nodiscard]]
+		int ImageHeight() const noexcept
+		{
+			return height;
+		}
+
+		[[nodiscard]]
+		size_t PixelCount() const noexcept
+		{
+			return background.size();
+		}
+
+		//PaletteSize RGB triples
+		[[nodiscard]]
+		const uint8_t* Palette() const noexcept
+		{
+			return palette;
+		}
+
+		//pixels needs PixelCount() bytes, a palette index each, rows top down. highlighted
+		//stones are drawn in the win colors
+		void Render(const Position& position, Bitboard highlighted, uint8_t* pixels) const noexcept
+		{
+			memcpy(pixels, background.data(), background.size());
+
+			Bitboard firstPlayer = position.PlayerStones(0);
+			Bitboard occupied = position.Occupied();
+
+			for (int x = 0; x < Width; x++)
+			{
+				for (int y = 0; y < Height; y++)
+				{
+					Bitboard cell = CellBit(x, Height - 1 - y);
+
+					if (!(occupied & cell))
+						continue;
+
+					const Tile& tile = tiles[x * Height + y];
+					size_t tileBytes = (size_t)tile.width * tile.height;
+
+					int front = ((firstPlayer & cell) ? 0 : 1) + ((highlighted & cell) ? 2 : 0);
+
+					const uint8_t* source = tilePixels.data() + tile.offset + front * tileBytes;
+					uint8_t* destination = pixels + (size_t)tile.top * width + tile.left;
+
+					for (int row = 0; row < tile.height; row++)
+						memcpy(destination + (size_t)row * width, source + (size_t)row * tile.width, tile.width);
+				}
+			}
+		}
+
+		//rgba needs PixelCount() * 4 bytes, alpha is always opaque
+		void ToRGBA(const uint8_t* pixels, uint8_t* rgba) const noexcept
+		{
+			for (size_t i = 0; i < background.size(); i++)
+			{
+				const uint8_t* color = &palette[pixels[i] * 3];
+
+				rgba[i * 4] = color[0];
+				rgba[i * 4 + 1] = color[1];
+				rgba[i * 4 + 2] = color[2];
+				rgba[i * 4 + 3] = 255;
+			}
+		}
+
+	private:
+		static constexpr int Samples = 4;
+
+		static constexpr SceneColor Black = { 0, 0, 0 };
+
+		struct Tile
+		{
+			int left;
+			int top;
+			int width;
+			int height;
+			size_t offset;
+		};
+
+		int width;
+		int height;
+		SceneLayout layout;
+
+		uint8_t palette[PaletteSize * 3];
+		std::vector<uint8_t> background;
+		Tile tiles[CellCount];
+		std::vector<uint8_t> tilePixels;
+
+		[[nodiscard]]
+		static int Clamp(int value, int limit) noexcept
+		{
+			return value < 0 ? 0 : value > limit ? limit : value;
+		}
+
+		[[nodiscard]]
+		static const SceneColor& Color(SceneBrush brush) noexcept
+		{
+			return SceneColors[(int)brush];
+		}
+
+		//front where the board does not cover, the board's color where it does
+		static void Blend(uint8_t* rgb, const SceneColor& front, const SceneColor& board, int cover) noexcept
+		{
+			constexpr float Full = Samples * Samples;
+
+			rgb[0] = (uint8_t)std::lround((front.r * (Full - cover) + board.r * cover) / Full * 255);
+			rgb[1] = (uint8_t)std::lround((front.g * (Full - cover) + board.g * cover) / Full * 255);
+			rgb[2] = (uint8_t)std::lround((front.b * (Full - cover) + board.b * cover) / Full * 255);
+		}
+
+		//how many of the pixel's samples land on the board and not in a hole
+		[[nodiscard]]
+		uint8_t BoardCoverage(int x, int y) const noexcept
+		{
+			int cover = 0;
+			float radius = layout.holeRadius;
+
+			for (int sy = 0; sy < Samples; sy++)
+			{
+				for (int sx = 0; sx < Samples; sx++)
+				{
+					float px = x + (sx + .5f) / Samples;
+					float py = y + (sy + .5f) / Samples;
+
+					if (px < layout.board.left || px >= layout.board.right || py < layout.board.top || py >= layout.board.bottom)
+						continue;
+
+					//rounding can put the last samples one cell over
+					int column = Clamp((int)((px - layout.board.left) * layout.columnsPerPixel), Width - 1);
+					int row = Clamp((int)((py - layout.board.top) / layout.squareSize), Height - 1);
+
+					ScenePoint center = layout.CellCenter(column, row);
+
+					float dx = px - center.x;
+					float dy = py - center.y;
+
+					if (dx * dx + dy * dy >= radius * radius)
+						cover++;
+				}
+			}
+
+			return (uint8_t)cover;
+		}
+	};
+
+	namespace Detail
+	{
+		//the CRC-32 table PNG chunks are checked with
+		struct CRCTable
+		{
+			uint32_t entries[256];
+
+			constexpr CRCTable() noexcept :
+				entries()
+			{
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t crc = i;
+
+					for (int bit = 0; bit < 8; bit++)
+						crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+
+					entries[i] = crc;
+				}
+			}
+		};
+
+		inline constexpr CRCTable PNGCRC = CRCTable();
+
+		//deflate's fixed Huffman codes, bit reversed since the stream is written least
+		//significant bit first. symbols 0 to 287 are literals, the end of block and lengths,
+		//the distance codes are 5 bits each
+		struct FixedHuffman
+		{
+			uint16_t symbols[288];
+			uint8_t symbolLengths[288];
+			uint8_t distances[30];
+
+			static constexpr uint16_t Reverse(uint32_t code, int length) noexcept
+			{
+				uint32_t reversed = 0;
+
+				for (int i = 0; i < length; i++)
+					reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+				return (uint16_t)reversed;
+			}
+
+			constexpr FixedHuffman() noexcept :
+				symbols(),
+				symbolLengths(),
+				distances()
+			{
+				for (int symbol = 0; symbol < 288; symbol++)
+				{
+					if (symbol < 144)
+					{
+						symbols[symbol] = Reverse(0x30 + symbol, 8);
+						symbolLengths[symbol] = 8;
+					}
+					else if (symbol < 256)
+					{
+						symbols[symbol] = Reverse(0x190 + symbol - 144, 9);
+						symbolLengths[symbol] = 9;
+					}
+					else if (symbol < 280)
+					{
+						symbols[symbol] = Reverse(symbol - 256, 7);
+						symbolLengths[symbol] = 7;
+					}
+					else
+					{
+						symbols[symbol] = Reverse(0xC0 + symbol - 280, 8);
+						symbolLengths[symbol] = 8;
+					}
+				}
+
+				for (int code = 0; code < 30; code++)
+					distances[code] = (uint8_t)Reverse(code, 5);
+			}
+		};
+
+		inline constexpr FixedHuffman DeflateCodes = FixedHuffman();
+	}
+
+	//turns RGBA images into file contents, keeping its buffers from one image to the next
+	class ImageEncoder
+	{
+	public:
+		//binary PPM of a palette image
+		[[nodiscard]]
+		const std::vector<uint8_t>& PPM(const uint8_t* pixels, int width, int height, const uint8_t* palette)
+		{
+			char header[48];
+			int headerLength = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+
+			size_t pixelCount = (size_t)width * height;
+
+			data.resize(headerLength + pixelCount * 3);
+			memcpy(data.data(), header, headerLength);
+
+			uint8_t* out = data.data() + headerLength;
+
+			for (size_t i = 0; i < pixelCount; i++)
+				memcpy(out + i * 3, palette + pixels[i] * 3, 3);
+
+			return data;
+		}
+
+		//8 bit palette PNG in one fixed Huffman deflate block, matched only against the pixel
+		//to the left and the pixel above
+		[[nodiscard]]
+		const std::vector<uint8_t>& PNG(const uint8_t* pixels, int width, int height, const uint8_t* palette, int paletteSize)
+		{
+			size_t rowBytes = (size_t)width;
+
+			//every row starts with its filter type, 0 for none
+			raw.resize((rowBytes + 1) * height);
+
+			for (int y = 0; y < height; y++)
+			{
+				raw[y * (rowBytes + 1)] = 0;
+				memcpy(&raw[y * (rowBytes + 1) + 1], pixels + y * rowBytes, rowBytes);
+			}
+
+			data.assign(Signature, Signature + sizeof(Signature));
+
+			uint8_t header[13];
+			PutBigEndian(header, (uint32_t)width);
+			PutBigEndian(header + 4, (uint32_t)height);
+			header[8] = 8;
+			header[9] = 3;
+			header[10] = 0;
+			header[11] = 0;
+			header[12] = 0;
+			Chunk("IHDR", header, sizeof(header));
+
+			Chunk("PLTE", palette, (size_t)paletteSize * 3);
+
+			Deflate(rowBytes + 1);
+			Chunk("IDAT", compressed.data(), compressed.size());
+
+			Chunk("IEND", nullptr, 0);
+
+			return data;
+		}
+
+	private:
+		static constexpr uint8_t Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+		static constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+		static constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		static constexpr size_t MaxMatch = 258;
+		static constexpr size_t Window = 32768;
+
+		std::vector<uint8_t> data;
+		std::vector<uint8_t> raw;
+		std::vector<uint8_t> compressed;
+
+		uint64_t bits = 0;
+		int bitCount = 0;
+		size_t compressedSize = 0;
+
+		static void PutBigEndian(uint8_t* out, uint32_t value) noexcept
+		{
+			out[0] = (uint8_t)(value >> 24);
+			out[1] = (uint8_t)(value >> 16);
+			out[2] = (uint8_t)(value >> 8);
+			out[3] = (uint8_t)value;
+		}
+
+		void Chunk(const char* type, const uint8_t* payload, size_t size)
+		{
+			uint8_t word[4];
+
+			PutBigEndian(word, (uint32_t)size);
+			data.insert(data.end(), word, word + 4);
+
+			size_t start = data.size();
+			data.insert(data.end(), type, type + 4);
+
+			if (size != 0)
+				data.insert(data.end(), payload, payload + size);
+
+			uint32_t crc = 0xFFFFFFFFu;
+
+			for (size_t i = start; i < data.size(); i++)
+				crc = Detail::PNGCRC.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+			PutBigEndian(word, crc ^ 0xFFFFFFFFu);
+			data.insert(data.end(), word, word + 4);
+		}
+
+		void PutBits(uint32_t value, int count)
+		{
+			bits |= (uint64_t)value << bitCount;
+			bitCount += count;
+
+			while (bitCount >= 8)
+			{
+				compressed[compressedSize++] = (uint8_t)bits;
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		void PutSymbol(int symbol)
+		{
+			PutBits(Detail::DeflateCodes.symbols[symbol], Detail::DeflateCodes.symbolLengths[symbol]);
+		}
+
+		void PutMatch(size_t length, size_t distance)
+		{
+			int code = 28;
+
+			while (LengthBase[code] > length)
+				code--;
+
+			PutSymbol(257 + code);
+			PutBits((uint32_t)(length - LengthBase[code]), LengthExtra[code]);
+
+			code = 29;
+
+			while (DistanceBase[code] > distance)
+				code--;
+
+			PutBits(Detail::DeflateCodes.distances[code], 5);
+			PutBits((uint32_t)(distance - DistanceBase[code]), DistanceExtra[code]);
+		}
+
+		//how far the bytes at i repeat the bytes distance back
+		[[nodiscard]]
+		size_t MatchLength(size_t i, size_t distance) const noexcept
+		{
+			size_t limit = raw.size() - i < MaxMatch ? raw.size() - i : MaxMatch;
+			size_t length = 0;
+
+			//eight bytes at a time, then the first that differs
+			while (length + 8 <= limit)
+			{
+				uint64_t here;
+				uint64_t back;
+
+				memcpy(&here, &raw[i + length], 8);
+				memcpy(&back, &raw[i + length - distance], 8);
+
+				if (here != back)
+					break;
+
+				length += 8;
+			}
+
+			while (length < limit && raw[i + length] == raw[i + length - distance])
+				length++;
+
+			return length;
+		}
+
+		//zlib stream of raw, rows are rowBytes apart
+		void Deflate(size_t rowBytes)
+		{
+			size_t size = raw.size();
+
+			//room for every byte as a 9 bit literal, the header and the checksum
+			compressed.resize(size + size / 8 + 16);
+			compressedSize = 0;
+			bits = 0;
+			bitCount = 0;
+
+			//deflate, 32K window, no dictionary, fastest
+			compressed[compressedSize++] = 0x78;
+			compressed[compressedSize++] = 0x01;
+
+			//final block, fixed codes
+			PutBits(1, 1);
+			PutBits(1, 2);
+
+			size_t i = 0;
+
+			while (i < size)
+			{
+				size_t length = 0;
+				size_t distance = 0;
+
+				if (i >= rowBytes && rowBytes <= Window)
+				{
+					length = MatchLength(i, rowBytes);
+					distance = rowBytes;
+				}
+
+				if (length < MaxMatch && i >= 1)
+				{
+					size_t left = MatchLength(i, 1);
+
+					if (left > length)
+					{
+						length = left;
+						distance = 1;
+					}
+				}
+
+				if (length >= 3)
+				{
+					PutMatch(length, distance);
+					i += length;
+				}
+				else
+				{
+					PutSymbol(raw[i]);
+					i++;
+				}
+			}
+
+			PutSymbol(256);
+
+			if (bitCount > 0)
+				PutBits(0, 8 - bitCount);
+
+			//5552 bytes is the most that can be summed before the modulo overflows 32 bits
+			uint32_t a = 1;
+			uint32_t b = 0;
+
+			for (size_t block = 0; block < size; block += 5552)
+			{
+				size_t blockEnd = block + 5552 < size ? block + 5552 : size;
+
+				for (size_t j = block; j < blockEnd; j++)
+				{
+					a += raw[j];
+					b += a;
+				}
+
+				a %= 65521;
+				b %= 65521;
+			}
+
+			PutBigEndian(&compressed[compressedSize], b << 16 | a);
+			compressed.resize(compressedSize + 4);
+		}
+	};
+}
@@ -0,0 +1,429 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ConnectFourCore.h"
+#include "ConnectFourMappedFile.h"
+
+//game records, binary for archives and text for people
+//
+//binary file layout:
+//
+//  GameFileHeader
+//  records, back to back:
+//    uint8_t   move count | result << 6
+//    uint8_t   moves[(3 * move count + 7) / 8]   3 bit columns, first move in the lowest bits
+//
+//a full 42 move game takes 17 bytes. there is no index, records are found by walking the
+//size bytes, which is cheap enough that SplitRecords() can hand a file to many threads.
+//
+//text form is the move string PlayMoves() takes followed by the result, "4453 1-0",
+//with 1-0 and 0-1 for a win by the first or second player, 1/2 for a draw and * for an
+//unfinished game
+
+namespace ConnectFour
+{
+	enum class GameResult : uint8_t
+	{
+		Unfinished = 0,
+		FirstPlayerWin = 1,
+		SecondPlayerWin = 2,
+		Draw = 3
+	};
+
+	struct GameFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint8_t width;
+		uint8_t height;
+		uint8_t reserved[6];
+	};
+
+	static_assert(sizeof(GameFileHeader) == 16);
+	static_assert(CellCount < 64, "move counts are stored in 6 bits");
+	static_assert(Width <= 8, "columns are stored in 3 bits");
+
+	constexpr char GameFileMagic[4] = { 'C', '4', 'G', 'R' };
+	constexpr uint32_t GameFileVersion = 1;
+
+	//DecodeGame() fills moves eight at a time
+	constexpr int MoveGroups = (CellCount + 7) / 8;
+
+	static_assert(MoveGroups == 6, "DecodeGame() splits two words into six groups");
+
+	struct GameRecord
+	{
+		int moveCount;
+		GameResult result;
+		uint8_t moves[MoveGroups * 8];
+	};
+
+	[[nodiscard]]
+	constexpr size_t RecordBytes(int moveCount) noexcept
+	{
+		return 1 + (3 * (size_t)moveCount + 7) / 8;
+	}
+
+	constexpr size_t MaxRecordBytes = RecordBytes(CellCount);
+
+	//out needs RecordBytes(record.moveCount) bytes, returns that many
+	inline size_t EncodeGame(const GameRecord& record, uint8_t* out) noexcept
+	{
+		out[0] = (uint8_t)(record.moveCount | (int)record.result << 6);
+
+		uint64_t bits = 0;
+		int bitCount = 0;
+		size_t size = 1;
+
+		for (int i = 0; i < record.moveCount; i++)
+		{
+			bits |= (uint64_t)record.moves[i] << bitCount;
+			bitCount += 3;
+
+			if (bitCount >= 8)
+			{
+				out[size++] = (uint8_t)bits;
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		if (bitCount > 0)
+			out[size++] = (uint8_t)bits;
+
+		return size;
+	}
+
+	//returns the bytes used, 0 if the record runs past the end of the data or is malformed
+	[[nodiscard]]
+	inline size_t DecodeGame(const uint8_t* data, size_t size, GameRecord& record) noexcept
+	{
+		if (size == 0)
+			return 0;
+
+		int moveCount = data[0] & 63;
+		size_t recordBytes = RecordBytes(moveCount);
+
+		if (moveCount > CellCount || recordBytes > size)
+			return 0;
+
+		record.moveCount = moveCount;
+		record.result = (GameResult)(data[0] >> 6);
+
+		//two little endian words cover the 126 bits of the longest game. bits past the
+		//record belong to the next one and are never looked at, only the last records of
+		//the data go through a padded copy so nothing is read past the end
+		uint64_t low;
+		uint64_t high;
+
+		if (size >= MaxRecordBytes)
+		{
+			memcpy(&low, data + 1, sizeof(low));
+			memcpy(&high, data + 9, sizeof(high));
+		}
+		else
+		{
+			uint8_t padded[16] = {};
+			memcpy(padded, data + 1, recordBytes - 1);
+			memcpy(&low, padded, sizeof(low));
+			memcpy(&high, padded + 8, sizeof(high));
+		}
+
+		//eight moves at a time, spreading 24 bits into one 3 bit move per byte. always all
+		//of them, whatever lands past moveCount is never read
+		uint64_t groups[MoveGroups] = { low, low >> 24, low >> 48 | high << 16, high >> 8, high >> 32, high >> 56 };
+
+		for (int i = 0; i < MoveGroups; i++)
+		{
+			uint64_t spread = groups[i] & 0xFFFFFF;
+			spread = (spread | spread << 20) & 0x00000FFF00000FFF;
+			spread = (spread | spread << 10) & 0x003F003F003F003F;
+			spread = (spread | spread << 5) & 0x0707070707070707;
+			memcpy(record.moves + 8 * i, &spread, sizeof(spread));
+		}
+
+		return recordBytes;
+	}
+
+	//plays the record through, false if a move is illegal, the game goes on after it was
+	//won or the stored result is not what the moves lead to. position gets the final board
+	//
+	//stones never leave the board, so a four made before the last move is still there one
+	//move from the end, and a stone dropped into a full column or past the last column
+	//leaves a bit outside FullBoard that no later move clears. that makes the checks a
+	//handful of instructions per game instead of per move
+	[[nodiscard]]
+	inline bool ReplayGame(const GameRecord& record, Position& position) noexcept
+	{
+		position = {};
+
+		if (record.moveCount == 0)
+			return record.result == GameResult::Unfinished;
+
+		for (int i = 0; i < record.moveCount - 1; i++)
+			position.Play((int)record.moves[i]);
+
+		Bitboard stones = position.CurrentStones() | position.OpponentStones();
+
+		if ((stones & ~FullBoard) || HasAlignment(position.CurrentStones()) || HasAlignment(position.OpponentStones()))
+			return false;
+
+		int last = record.moves[record.moveCount - 1];
+
+		if (last >= Width || !position.CanPlay(last))
+			return false;
+
+		bool won = position.IsWinningMove(last);
+		position.Play(last);
+
+		if (won)
+			return record.result == (record.moveCount % 2 == 1 ? GameResult::FirstPlayerWin : GameResult::SecondPlayerWin);
+
+		return record.result == (position.IsFull() ? GameResult::Draw : GameResult::Unfinished);
+	}
+
+	//text needs room for CellCount + 5 characters, returns the length written
+	inline size_t FormatGame(const GameRecord& record, char* text) noexcept
+	{
+		static constexpr const char* resultText[] = { "*", "1-0", "0-1", "1/2" };
+
+		size_t length = 0;
+
+		for (int i = 0; i < record.moveCount; i++)
+			text[length++] = (char)('1' + record.moves[i]);
+
+		text[length++] = ' ';
+
+		for (const char* result = resultText[(int)record.result]; *result != '\0'; result++)
+			text[length++] = *result;
+
+		text[length] = '\0';
+		return length;
+	}
+
+	//false if the line is not a move string followed by a result, the moves are not checked
+	[[nodiscard]]
+	inline bool ParseGame(const char* text, GameRecord& record) noexcept
+	{
+		record.moveCount = 0;
+
+		for (; *text >= '1' && *text <= '0' + Width; text++)
+		{
+			if (record.moveCount == CellCount)
+				return false;
+
+			record.moves[record.moveCount++] = (uint8_t)(*text - '1');
+		}
+
+		while (*text == ' ' || *text == '\t')
+			text++;
+
+		if (strncmp(text, "1-0", 3) == 0)
+			record.result = GameResult::FirstPlayerWin;
+		else if (strncmp(text, "0-1", 3) == 0)
+			record.result = GameResult::SecondPlayerWin;
+		else if (strncmp(text, "1/2", 3) == 0)
+			record.result = GameResult::Draw;
+		else if (*text == '*')
+			record.result = GameResult::Unfinished;
+		else
+			return false;
+
+		return true;
+	}
+
+	//appends records to a file, writing the header first if the file is new
+	class GameWriter
+	{
+	public:
+		GameWriter() noexcept = default;
+
+		~GameWriter()
+		{
+			(void)Close();
+		}
+
+		GameWriter(const GameWriter&) = delete;
+		GameWriter& operator=(const GameWriter&) = delete;
+
+		[[nodiscard]]
+		bool Open(const char* path) noexcept
+		{
+			(void)Close();
+
+			file = fopen(path, "ab");
+
+			if (file == nullptr)
+				return false;
+
+			fseek(file, 0, SEEK_END);
+
+			if (ftell(file) == 0)
+			{
+				GameFileHeader header = {};
+				memcpy(header.magic, GameFileMagic, sizeof(GameFileMagic));
+				header.version = GameFileVersion;
+				header.width = Width;
+				header.height = Height;
+
+				if (fwrite(&header, sizeof(header), 1, file) != 1)
+				{
+					(void)Close();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		[[nodiscard]]
+		bool Write(const GameRecord& record) noexcept
+		{
+			uint8_t buffer[MaxRecordBytes];
+			size_t size = EncodeGame(record, buffer);
+			return Write(buffer, size);
+		}
+
+		//records already encoded with EncodeGame()
+		[[nodiscard]]
+		bool Write(const uint8_t* records, size_t size) noexcept
+		{
+			return file != nullptr && fwrite(records, 1, size, file) == size;
+		}
+
+		[[nodiscard]]
+		bool Flush() noexcept
+		{
+			return file != nullptr && fflush(file) == 0;
+		}
+
+		[[nodiscard]]
+		bool Close() noexcept
+		{
+			if (file == nullptr)
+				return true;
+
+			bool closed = fclose(file) == 0;
+			file = nullptr;
+			return closed;
+		}
+
+	private:
+		FILE* file = nullptr;
+	};
+
+	//walks the records between begin and end
+	struct RecordCursor
+	{
+		const uint8_t* position;
+		const uint8_t* end;
+
+		//false at the end, at a record cut short or at a malformed one, and it stays there
+		[[nodiscard]]
+		bool Next(GameRecord& record) noexcept
+		{
+			size_t size = DecodeGame(position, (size_t)(end - position), record);
+			position += size;
+			return size != 0;
+		}
+
+		[[nodiscard]]
+		bool AtEnd() const noexcept
+		{
+			return position == end;
+		}
+
+		//Next() stopped at a record that can not be one, with more moves than the board has
+		//cells. a record stopped at that is not corrupt runs past the end of the data
+		[[nodiscard]]
+		bool AtCorruptRecord() const noexcept
+		{
+			return position < end && (*position & 63) > CellCount;
+		}
+	};
+
+	//memory mapped archive of records
+	class GameArchive
+	{
+	public:
+		//false if the file is missing or is not a record file for this board size
+		[[nodiscard]]
+		bool Open(const char* path) noexcept
+		{
+			Close();
+
+			if (!file.Open(path, MappedFile::Access::Sequential))
+				return false;
+
+			const GameFileHeader* header = (const GameFileHeader*)file.Data();
+
+			if (file.Size() < sizeof(GameFileHeader) ||
+				memcmp(header->magic, GameFileMagic, sizeof(GameFileMagic)) != 0 ||
+				header->version != GameFileVersion ||
+				header->width != Width ||
+				header->height != Height)
+			{
+				Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void Close() noexcept
+		{
+			file.Close();
+		}
+
+		[[nodiscard]]
+		RecordCursor Records() const noexcept
+		{
+			if (file.Data() == nullptr)
+				return { nullptr, nullptr };
+
+			return { file.Data() + sizeof(GameFileHeader), file.Data() + file.Size() };
+		}
+
+		//cuts the records into up to parts cursors of about the same size, on record boundaries
+		[[nodiscard]]
+		std::vector<RecordCursor> SplitRecords(int parts) const
+		{
+			RecordCursor all = Records();
+			std::vector<RecordCursor> cursors;
+
+			size_t total = (size_t)(all.end - all.position);
+			size_t target = total / (parts < 1 ? 1 : parts) + 1;
+
+			const uint8_t* start = all.position;
+			const uint8_t* position = all.position;
+
+			while (position < all.end)
+			{
+				position += RecordBytes(*position & 63);
+
+				if (position >= all.end || (size_t)(position - start) >= target)
+				{
+					//a truncated last record is left for the cursor to report
+					const uint8_t* stop = position < all.end ? position : all.end;
+					cursors.push_back({ start, stop });
+					start = stop;
+				}
+			}
+
+			return cursors;
+		}
+
+	private:
+		MappedFile file;
+	};
+}
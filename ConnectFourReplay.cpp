@@ -0,0 +1,251 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//replays and verifies a game record file, or converts between text and binary records
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourReplay.cpp -o ConnectFourReplay
+//usage: ConnectFourReplay [-threads N] [-print] FILE
+//       ConnectFourReplay -import TEXT -o FILE
+//
+//replaying maps the file and splits it over the threads, every game is played through
+//and checked against its stored result. prints the totals and the replay speed, with
+//-print every game is also written out as text. -import appends one game per line of a
+//text file, in the "4453 1-0" form, to a record file
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourRecord.h"
+
+using namespace ConnectFour;
+
+struct ReplayTotals
+{
+	uint64_t games = 0;
+	uint64_t moves = 0;
+	uint64_t invalid = 0;
+	uint64_t results[4] = {};
+
+	//where the cursor stopped before the end of its part, a corrupt record or one cut short
+	bool stopped = false;
+	bool corrupt = false;
+	const uint8_t* stop = nullptr;
+};
+
+static void ReplayRecords(RecordCursor cursor, ReplayTotals& totals) noexcept
+{
+	GameRecord record;
+	Position position;
+
+	while (cursor.Next(record))
+	{
+		totals.games++;
+		totals.moves += record.moveCount;
+
+		if (ReplayGame(record, position))
+			totals.results[(int)record.result]++;
+		else
+			totals.invalid++;
+	}
+
+	totals.stopped = !cursor.AtEnd();
+	totals.corrupt = cursor.AtCorruptRecord();
+	totals.stop = cursor.position;
+}
+
+static int Import(const char* textPath, const char* outputPath) noexcept
+{
+	FILE* text = fopen(textPath, "r");
+
+	if (text == nullptr)
+	{
+		fprintf(stderr, "unable to open %s\n", textPath);
+		return EXIT_FAILURE;
+	}
+
+	GameWriter writer;
+
+	if (!writer.Open(outputPath))
+	{
+		fprintf(stderr, "unable to open %s\n", outputPath);
+		fclose(text);
+		return EXIT_FAILURE;
+	}
+
+	char line[256];
+	int lineNumber = 0;
+	uint64_t games = 0;
+	uint64_t rejected = 0;
+
+	while (fgets(line, sizeof(line), text) != nullptr)
+	{
+		lineNumber++;
+
+		if (line[0] == '\n' || line[0] == '\r' || line[0] == '#')
+			continue;
+
+		GameRecord record;
+		Position position;
+
+		if (!ParseGame(line, record) || !ReplayGame(record, position))
+		{
+			fprintf(stderr, "%s:%d: not a valid game\n", textPath, lineNumber);
+			rejected++;
+			continue;
+		}
+
+		if (!writer.Write(record))
+		{
+			fprintf(stderr, "unable to write %s\n", outputPath);
+			fclose(text);
+			return EXIT_FAILURE;
+		}
+
+		games++;
+	}
+
+	fclose(text);
+
+	if (!writer.Close())
+	{
+		fprintf(stderr, "unable to write %s\n", outputPath);
+		return EXIT_FAILURE;
+	}
+
+	printf("%llu games imported, %llu rejected\n", (unsigned long long)games, (unsigned long long)rejected);
+	return rejected == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+	int threadCount = (int)std::thread::hardware_concurrency();
+	bool print = false;
+	const char* importPath = nullptr;
+	const char* outputPath = nullptr;
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-print") == 0)
+			print = true;
+		else if (strcmp(argv[i], "-import") == 0 && i + 1 < argc)
+			importPath = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (argv[i][0] != '-' && path == nullptr)
+			path = argv[i];
+		else
+		{
+			path = nullptr;
+			importPath = nullptr;
+			break;
+		}
+	}
+
+	if (importPath != nullptr && outputPath != nullptr)
+		return Import(importPath, outputPath);
+
+	if (path == nullptr)
+	{
+		fprintf(stderr, "usage: %s [-threads N] [-print] FILE\n", argv[0]);
+		fprintf(stderr, "       %s -import TEXT -o FILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	GameArchive archive;
+
+	if (!archive.Open(path))
+	{
+		fprintf(stderr, "unable to open %s, or it is not a %dx%d game record file\n", path, Width, Height);
+		return EXIT_FAILURE;
+	}
+
+	if (print)
+	{
+		RecordCursor cursor = archive.Records();
+		GameRecord record;
+		Position position;
+		char text[CellCount + 8];
+
+		while (cursor.Next(record))
+		{
+			FormatGame(record, text);
+			printf("%s%s\n", text, ReplayGame(record, position) ? "" : " invalid");
+		}
+	}
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<RecordCursor> parts = archive.SplitRecords(threadCount);
+	std::vector<ReplayTotals> results(parts.size());
+
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < parts.size(); i++)
+		helpers.emplace_back(ReplayRecords, parts[i], std::ref(results[i]));
+
+	if (!parts.empty())
+		ReplayRecords(parts[0], results[0]);
+
+	for (std::thread& helper : helpers)
+		helper.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ReplayTotals total;
+	RecordCursor all = archive.Records();
+
+	//records after a corrupt one are misread, so only the first stop is reported
+	uint64_t problems = 0;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const ReplayTotals& part = results[i];
+
+		total.games += part.games;
+		total.moves += part.moves;
+		total.invalid += part.invalid;
+
+		for (int j = 0; j < 4; j++)
+			total.results[j] += part.results[j];
+
+		if (!part.stopped || problems++ != 0)
+			continue;
+
+		unsigned long long offset = (unsigned long long)(part.stop - all.position + sizeof(GameFileHeader));
+
+		//parts end on record boundaries, so only the file's last record can be cut short
+		if (part.corrupt)
+			printf("the record at byte %llu is corrupt, it claims %d moves\n", offset, *part.stop & 63);
+		else if (parts[i].end == all.end)
+			printf("the last record, at byte %llu, is cut short\n", offset);
+		else
+			printf("the record at byte %llu is corrupt, it runs into the next one\n", offset);
+	}
+
+	double bytes = (double)(all.end - all.position);
+
+	printf("%llu games, %llu moves in %.3f s on %zu threads\n",
+		(unsigned long long)total.games, (unsigned long long)total.moves, seconds, parts.size());
+	printf("%.1f M moves/s, %.2f GB/s\n", total.moves / seconds / 1e6, bytes / seconds / 1e9);
+	printf("first player wins %llu, second player wins %llu, draws %llu, unfinished %llu\n",
+		(unsigned long long)total.results[(int)GameResult::FirstPlayerWin],
+		(unsigned long long)total.results[(int)GameResult::SecondPlayerWin],
+		(unsigned long long)total.results[(int)GameResult::Draw],
+		(unsigned long long)total.results[(int)GameResult::Unfinished]);
+	printf("invalid %llu\n", (unsigned long long)total.invalid);
+
+	return total.invalid == 0 && problems == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,555 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//strong solution of a small board by retrograde analysis
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourRetrograde.cpp -o ConnectFourRetrograde
+//usage: ConnectFourRetrograde -size WxH [-threads N] [-o FILE] [-verify N] [-seed N]
+//       ConnectFourRetrograde -size WxH -probe MOVES [-o FILE]
+//
+//sizes: 4x4 5x4 6x4 7x4 4x5 5x5 6x5 4x6, always four in a row
+//
+//collects every position that can be reached in play, one layer of stones at a time on
+//all threads, builds a minimal perfect hash over them and labels every position win, draw
+//or loss from the deepest layer back to the empty board. the table ConnectFourStrongTable.h
+//maps is written to FILE, ConnectFour<W>x<H>.table unless given.
+//
+//-verify solves N random positions with the search engine and compares them with the
+//table. -probe prints the outcome and best move of the position after MOVES
+//
+//all keys are held in memory, 8 bytes per position and mirrored pair: 0.2 to 0.3 GB for
+//5x5 and 6x4, many GB for 6x5
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourSolver.h"
+#include "ConnectFourStrongTable.h"
+
+using namespace ConnectFour;
+
+//bits per key in each level of the perfect hash, more builds faster and looks up with
+//fewer levels at the cost of a larger file
+constexpr double HashLevelBitsPerKey = 2.0;
+
+struct Options
+{
+	int threadCount;
+	const char* outputPath;
+	const char* probeMoves;
+	int verifyCount;
+	uint64_t seed;
+};
+
+//runs worker(index) on threadCount threads, this one included
+template<typename Worker>
+static void RunOnThreads(int threadCount, Worker&& worker)
+{
+	std::vector<std::thread> helpers;
+	for (int i = 1; i < threadCount; i++)
+		helpers.emplace_back(worker, i);
+
+	worker(0);
+
+	for (std::thread& helper : helpers)
+		helper.join();
+}
+
+//the part of count the thread with this index works on
+[[nodiscard]]
+static std::pair<size_t, size_t> ThreadRange(size_t count, int index, int threadCount) noexcept
+{
+	return { count * index / threadCount, count * (index + 1) / threadCount };
+}
+
+[[nodiscard]]
+static double SecondsSince(std::chrono::steady_clock::time_point start) noexcept
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+class PerfectHashBuilder
+{
+public:
+	//keys have to be distinct, false if they are not and no hash could be found
+	[[nodiscard]]
+	bool Build(const std::vector<std::vector<uint64_t>>& layers, int threadCount)
+	{
+		levelWords.clear();
+		hashBits.clear();
+		keyCount = 0;
+
+		for (const std::vector<uint64_t>& layer : layers)
+			keyCount += layer.size();
+
+		//level 0 hashes the layers in place, later levels only the keys that collided
+		std::vector<std::span<const uint64_t>> sources(layers.begin(), layers.end());
+		std::vector<uint64_t> remaining;
+		uint64_t remainingCount = keyCount;
+
+		for (int level = 0; remainingCount > 0; level++)
+		{
+			if (level == MaxHashLevels)
+				return false;
+
+			uint64_t words = (uint64_t)(remainingCount * HashLevelBitsPerKey / 64) + 1;
+			std::vector<uint64_t> seen(words);
+			std::vector<uint64_t> collided(words);
+
+			auto ForEachKey = [&](int index, auto&& action)
+			{
+				for (std::span<const uint64_t> source : sources)
+				{
+					auto [begin, end] = ThreadRange(source.size(), index, threadCount);
+
+					for (size_t i = begin; i < end; i++)
+						action(source[i]);
+				}
+			};
+
+			auto BitOf = [&](uint64_t key)
+			{
+				return PerfectHashMix(key, level) % (words * 64);
+			};
+
+			RunOnThreads(threadCount, [&](int index)
+			{
+				ForEachKey(index, [&](uint64_t key)
+				{
+					uint64_t bit = BitOf(key);
+					uint64_t select = 1ull << (bit % 64);
+
+					if (std::atomic_ref(seen[bit / 64]).fetch_or(select, std::memory_order_relaxed) & select)
+						std::atomic_ref(collided[bit / 64]).fetch_or(select, std::memory_order_relaxed);
+				});
+			});
+
+			//keys that shared a bit try again on the next level
+			std::vector<std::vector<uint64_t>> retry(threadCount);
+
+			RunOnThreads(threadCount, [&](int index)
+			{
+				ForEachKey(index, [&](uint64_t key)
+				{
+					uint64_t bit = BitOf(key);
+
+					if (collided[bit / 64] & (1ull << (bit % 64)))
+						retry[index].push_back(key);
+				});
+			});
+
+			std::vector<uint64_t> next;
+			for (std::vector<uint64_t>& keys : retry)
+				next.insert(next.end(), keys.begin(), keys.end());
+
+			for (uint64_t i = 0; i < words; i++)
+				hashBits.push_back(seen[i] & ~collided[i]);
+
+			levelWords.push_back(words);
+
+			remaining = std::move(next);
+			remainingCount = remaining.size();
+			sources.assign(1, remaining);
+		}
+
+		rankCounts.assign(hashBits.size() / 8 + 1, 0);
+
+		uint64_t rank = 0;
+		for (size_t i = 0; i < hashBits.size(); i++)
+		{
+			if (i % 8 == 0)
+				rankCounts[i / 8] = rank;
+
+			rank += PopCount(hashBits[i]);
+		}
+
+		if (hashBits.size() % 8 == 0)
+			rankCounts.back() = rank;
+
+		return rank == keyCount;
+	}
+
+	[[nodiscard]]
+	PerfectHash View() const noexcept
+	{
+		return {
+			.levelCount = (int)levelWords.size(),
+			.keyCount = keyCount,
+			.levelWords = levelWords.data(),
+			.hashBits = hashBits.data(),
+			.rankCounts = rankCounts.data()
+		};
+	}
+
+	std::vector<uint64_t> levelWords;
+	std::vector<uint64_t> hashBits;
+	std::vector<uint64_t> rankCounts;
+	uint64_t keyCount = 0;
+};
+
+template<int BoardWidth, int BoardHeight>
+static int Probe(const Options& options)
+{
+	using PositionType = BasicPosition<BoardWidth, BoardHeight, 4>;
+
+	BasicStrongTable<BoardWidth, BoardHeight, 4> table;
+
+	if (!table.Open(options.outputPath))
+	{
+		fprintf(stderr, "unable to open %s, or it is not a %dx%d table\n", options.outputPath, BoardWidth, BoardHeight);
+		return EXIT_FAILURE;
+	}
+
+	PositionType position;
+
+	if (!PlayMoves(position, options.probeMoves))
+	{
+		fprintf(stderr, "invalid moves: %s\n", options.probeMoves);
+		return EXIT_FAILURE;
+	}
+
+	static constexpr const char* outcomeText[] = { "unknown", "loss", "draw", "win" };
+
+	int column;
+	Outcome outcome;
+
+	if (!table.BestMove(position, column, &outcome))
+	{
+		printf("%s: no moves\n", outcomeText[(int)table.Lookup(position)]);
+		return EXIT_SUCCESS;
+	}
+
+	printf("%s, best move %d\n", outcomeText[(int)outcome], column + 1);
+	return EXIT_SUCCESS;
+}
+
+template<int BoardWidth, int BoardHeight>
+static int Verify(const Options& options)
+{
+	using PositionType = BasicPosition<BoardWidth, BoardHeight, 4>;
+
+	BasicStrongTable<BoardWidth, BoardHeight, 4> table;
+
+	if (!table.Open(options.outputPath))
+	{
+		fprintf(stderr, "unable to open %s\n", options.outputPath);
+		return EXIT_FAILURE;
+	}
+
+	TranspositionTable transpositionTable(64 << 20);
+	BasicSolver<BoardWidth, BoardHeight, 4> solver(transpositionTable);
+	std::mt19937_64 rng(options.seed);
+
+	int mismatches = 0;
+
+	for (int i = 0; i < options.verifyCount; i++)
+	{
+		//a random game cut off at a random point before it ends
+		PositionType position;
+		int stones = (int)(rng() % (BoardWidth * BoardHeight));
+
+		while (position.MoveCount() < stones)
+		{
+			int column = (int)(rng() % BoardWidth);
+
+			if (!position.CanPlay(column))
+				continue;
+
+			if (position.IsWinningMove(column))
+				break;
+
+			position.Play(column);
+		}
+
+		int result = solver.SolveWeak(position);
+		Outcome expected = result > 0 ? Outcome::Win : result < 0 ? Outcome::Loss : Outcome::Draw;
+
+		if (table.Lookup(position) != expected)
+			mismatches++;
+	}
+
+	printf("verified %d positions against the solver, %d mismatches\n", options.verifyCount, mismatches);
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+template<int BoardWidth, int BoardHeight>
+static int Build(const Options& options)
+{
+	using PositionType = BasicPosition<BoardWidth, BoardHeight, 4>;
+
+	constexpr int CellCount = BoardWidth * BoardHeight;
+	const int threadCount = options.threadCount;
+
+	auto start = std::chrono::steady_clock::now();
+
+	//layers[i] holds the canonical keys of the positions with i stones where nobody has
+	//four in a row, each once
+	std::vector<std::vector<uint64_t>> layers(1, std::vector<uint64_t>(1, 0));
+
+	for (int stones = 0; stones < CellCount; stones++)
+	{
+		const std::vector<uint64_t>& layer = layers.back();
+
+		//every thread sorts the children into one bucket per thread by hash, so each
+		//thread can then deduplicate its share of the next layer on its own
+		std::vector<std::vector<std::vector<uint64_t>>> buckets(threadCount, std::vector<std::vector<uint64_t>>(threadCount));
+		std::vector<std::vector<uint64_t>> shards(threadCount);
+
+		RunOnThreads(threadCount, [&](int index)
+		{
+			auto [begin, end] = ThreadRange(layer.size(), index, threadCount);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				PositionType position = PositionType::FromKey(layer[i]);
+
+				for (int x = 0; x < BoardWidth; x++)
+				{
+					//a winning move ends the game, there is nothing to store for the position after it
+					if (!position.CanPlay(x) || position.IsWinningMove(x))
+						continue;
+
+					PositionType child = position;
+					child.Play(x);
+
+					uint64_t key = child.CanonicalKey();
+					buckets[index][PerfectHashMix(key, -1) % threadCount].push_back(key);
+				}
+			}
+		});
+
+		RunOnThreads(threadCount, [&](int index)
+		{
+			std::vector<uint64_t>& shard = shards[index];
+
+			for (int source = 0; source < threadCount; source++)
+			{
+				shard.insert(shard.end(), buckets[source][index].begin(), buckets[source][index].end());
+				std::vector<uint64_t>().swap(buckets[source][index]);
+			}
+
+			std::sort(shard.begin(), shard.end());
+			shard.erase(std::unique(shard.begin(), shard.end()), shard.end());
+		});
+
+		std::vector<uint64_t> next;
+
+		for (std::vector<uint64_t>& shard : shards)
+		{
+			next.insert(next.end(), shard.begin(), shard.end());
+			std::vector<uint64_t>().swap(shard);
+		}
+
+		if (next.empty())
+			break;
+
+		layers.push_back(std::move(next));
+	}
+
+	uint64_t positionCount = 0;
+	for (const std::vector<uint64_t>& layer : layers)
+		positionCount += layer.size();
+
+	printf("%dx%d: %llu positions in %zu layers (%.1f s)\n", BoardWidth, BoardHeight, (unsigned long long)positionCount, layers.size(), SecondsSince(start));
+
+	PerfectHashBuilder builder;
+
+	if (!builder.Build(layers, threadCount))
+	{
+		fprintf(stderr, "unable to build the perfect hash\n");
+		return EXIT_FAILURE;
+	}
+
+	PerfectHash hash = builder.View();
+
+	printf("perfect hash: %d levels, %.2f bits per position (%.1f s)\n",
+		hash.levelCount, (builder.hashBits.size() + builder.rankCounts.size()) * 64.0 / positionCount, SecondsSince(start));
+
+	//2 bits per position, written by many threads at once so every word is updated atomically
+	std::vector<uint64_t> outcomes(positionCount / 32 + 1);
+
+	auto OutcomeOf = [&](const PositionType& position)
+	{
+		uint64_t index = 0;
+		(void)hash.Index(position.CanonicalKey(), index);
+		return (Outcome)((std::atomic_ref(outcomes[index / 32]).load(std::memory_order_relaxed) >> (2 * (index % 32))) & 3);
+	};
+
+	for (int stones = (int)layers.size() - 1; stones >= 0; stones--)
+	{
+		const std::vector<uint64_t>& layer = layers[stones];
+
+		RunOnThreads(threadCount, [&](int index)
+		{
+			auto [begin, end] = ThreadRange(layer.size(), index, threadCount);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				PositionType position = PositionType::FromKey(layer[i]);
+				Outcome best = position.IsFull() ? Outcome::Draw : Outcome::Loss;
+
+				if (position.CanWinNext())
+				{
+					best = Outcome::Win;
+				}
+				else
+				{
+					for (int x = 0; x < BoardWidth && best != Outcome::Win; x++)
+					{
+						if (!position.CanPlay(x))
+							continue;
+
+						PositionType child = position;
+						child.Play(x);
+
+						Outcome outcome = FlipOutcome(OutcomeOf(child));
+
+						if ((uint8_t)outcome > (uint8_t)best)
+							best = outcome;
+					}
+				}
+
+				uint64_t slot = 0;
+				(void)hash.Index(layer[i], slot);
+				std::atomic_ref(outcomes[slot / 32]).fetch_or((uint64_t)best << (2 * (slot % 32)), std::memory_order_relaxed);
+			}
+		});
+	}
+
+	static constexpr const char* outcomeText[] = { "unknown", "loss", "draw", "win" };
+	printf("empty board: %s for the first player (%.1f s)\n", outcomeText[(int)OutcomeOf(PositionType())], SecondsSince(start));
+
+	FILE* file = fopen(options.outputPath, "wb");
+
+	if (file == nullptr)
+	{
+		fprintf(stderr, "unable to open %s\n", options.outputPath);
+		return EXIT_FAILURE;
+	}
+
+	StrongTableHeader header = {};
+	memcpy(header.magic, StrongTableMagic, sizeof(StrongTableMagic));
+	header.version = StrongTableVersion;
+	header.width = BoardWidth;
+	header.height = BoardHeight;
+	header.connect = 4;
+	header.levelCount = (uint8_t)hash.levelCount;
+	header.positionCount = positionCount;
+	header.hashWords = builder.hashBits.size();
+
+	bool written =
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(builder.levelWords.data(), sizeof(uint64_t), builder.levelWords.size(), file) == builder.levelWords.size() &&
+		fwrite(builder.hashBits.data(), sizeof(uint64_t), builder.hashBits.size(), file) == builder.hashBits.size() &&
+		fwrite(builder.rankCounts.data(), sizeof(uint64_t), builder.rankCounts.size(), file) == builder.rankCounts.size() &&
+		fwrite(outcomes.data(), sizeof(uint64_t), outcomes.size(), file) == outcomes.size();
+
+	if (fclose(file) != 0 || !written)
+	{
+		fprintf(stderr, "unable to write %s\n", options.outputPath);
+		return EXIT_FAILURE;
+	}
+
+	printf("wrote %s (%.1f MB) in %.1f s\n", options.outputPath,
+		(sizeof(header) + (builder.levelWords.size() + builder.hashBits.size() + builder.rankCounts.size() + outcomes.size()) * 8) / 1e6, SecondsSince(start));
+
+	return options.verifyCount > 0 ? Verify<BoardWidth, BoardHeight>(options) : EXIT_SUCCESS;
+}
+
+template<int BoardWidth, int BoardHeight>
+static int Run(const Options& options)
+{
+	return options.probeMoves != nullptr ? Probe<BoardWidth, BoardHeight>(options) : Build<BoardWidth, BoardHeight>(options);
+}
+
+struct BoardSize
+{
+	int width;
+	int height;
+	int (*run)(const Options&);
+};
+
+static constexpr BoardSize BoardSizes[] =
+{
+	{ 4, 4, Run<4, 4> },
+	{ 5, 4, Run<5, 4> },
+	{ 6, 4, Run<6, 4> },
+	{ 7, 4, Run<7, 4> },
+	{ 4, 5, Run<4, 5> },
+	{ 5, 5, Run<5, 5> },
+	{ 6, 5, Run<6, 5> },
+	{ 4, 6, Run<4, 6> }
+};
+
+int main(int argc, char** argv)
+{
+	Options options = {
+		.threadCount = (int)std::thread::hardware_concurrency(),
+		.outputPath = nullptr,
+		.probeMoves = nullptr,
+		.verifyCount = 0,
+		.seed = 1
+	};
+
+	int width = 0;
+	int height = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-size") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+			i++;
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			options.threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			options.outputPath = argv[++i];
+		else if (strcmp(argv[i], "-probe") == 0 && i + 1 < argc)
+			options.probeMoves = argv[++i];
+		else if (strcmp(argv[i], "-verify") == 0 && i + 1 < argc)
+			options.verifyCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			options.seed = strtoull(argv[++i], nullptr, 10);
+		else
+		{
+			width = 0;
+			break;
+		}
+	}
+
+	const BoardSize* size = nullptr;
+
+	for (const BoardSize& candidate : BoardSizes)
+	{
+		if (candidate.width == width && candidate.height == height)
+			size = &candidate;
+	}
+
+	if (size == nullptr)
+	{
+		fprintf(stderr, "usage: %s -size WxH [-threads N] [-o FILE] [-verify N] [-seed N]\n", argv[0]);
+		fprintf(stderr, "       %s -size WxH -probe MOVES [-o FILE]\n", argv[0]);
+		fprintf(stderr, "sizes: 4x4 5x4 6x4 7x4 4x5 5x5 6x5 4x6\n");
+		return EXIT_FAILURE;
+	}
+
+	if (options.threadCount < 1)
+		options.threadCount = 1;
+
+	char defaultPath[64];
+	snprintf(defaultPath, sizeof(defaultPath), "ConnectFour%dx%d.table", width, height);
+
+	if (options.outputPath == nullptr)
+		options.outputPath = defaultPath;
+
+	return size->run(options);
+}
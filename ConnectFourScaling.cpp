@@ -0,0 +1,127 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//thread scaling report for the parallel solver
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourScaling.cpp -o ConnectFourScaling
+//usage: ConnectFourScaling [-stones N] [-positions N] [-hash MB] [-pin] [-seed N]
+//
+//solves the same set of positions at 1, 2, 4, 8 and 16 threads with a cleared table
+//each time and prints nodes/sec and wall clock time to solve the whole set
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "ConnectFourParallelSolver.h"
+
+using namespace ConnectFour;
+
+//plays random non-losing moves so the position is still undecided at the end
+[[nodiscard]]
+static bool RandomPosition(std::mt19937_64& rng, int stones, Position& position) noexcept
+{
+	position = {};
+
+	while (position.MoveCount() < stones)
+	{
+		if (position.CanWinNext())
+			return false;
+
+		Bitboard moves = position.PossibleNonLosingMoves();
+
+		if (moves == 0)
+			return false;
+
+		int column;
+		do
+		{
+			column = (int)(rng() % Width);
+		} while ((moves & ColumnMask(column)) == 0);
+
+		position.Play(column);
+	}
+
+	return !position.CanWinNext();
+}
+
+int main(int argc, char** argv)
+{
+	int stones = 10;
+	int positionCount = 8;
+	size_t hashMegabytes = 256;
+	bool pinThreads = false;
+	uint64_t seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-stones") == 0 && i + 1 < argc)
+			stones = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-positions") == 0 && i + 1 < argc)
+			positionCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-pin") == 0)
+			pinThreads = true;
+		else
+		{
+			fprintf(stderr, "usage: %s [-stones N] [-positions N] [-hash MB] [-pin] [-seed N]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::mt19937_64 rng(seed);
+	std::vector<Position> positions;
+
+	while ((int)positions.size() < positionCount)
+	{
+		Position position;
+		if (RandomPosition(rng, stones, position))
+			positions.push_back(position);
+	}
+
+	TranspositionTable table(hashMegabytes << 20, true);
+
+	printf("%d positions of %d stones, %zu MB table%s, %u hardware threads\n",
+		positionCount, stones, table.SizeBytes() >> 20, table.UsesHugePages() ? " (huge pages)" : "", std::thread::hardware_concurrency());
+	printf("%8s %14s %12s %12s %9s\n", "threads", "nodes", "Mnodes/s", "seconds", "speedup");
+
+	double baseline = 0;
+
+	for (int threads : { 1, 2, 4, 8, 16 })
+	{
+		ParallelSolver solver(table, threads, pinThreads);
+		table.Clear();
+
+		uint64_t nodes = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (const Position& position : positions)
+		{
+			volatile int score = solver.Solve(position);
+			(void)score;
+			nodes += solver.NodeCount();
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (threads == 1)
+			baseline = seconds;
+
+		//threads beyond the cores only share them, their speedup says nothing about scaling
+		bool oversubscribed = std::thread::hardware_concurrency() != 0 && (unsigned)threads > std::thread::hardware_concurrency();
+
+		printf("%8d %14llu %12.2f %12.3f %8.2fx%s\n", threads, (unsigned long long)nodes, nodes / seconds / 1e6, seconds, baseline / seconds,
+			oversubscribed ? "  more threads than cores" : "");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,515 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "ConnectFourGameFlow.h"
+
+//the game screen as a retained list of items, redrawn only where it changed
+//
+//every frame Scene::Update() lays the state out as items: the names and scores, a rectangle
+//per board cell, the piece over the board and the board itself. each item that differs from
+//the last frame marks its old and new bounds dirty, and each dirty region is repainted:
+//clipped, cleared, and every item that touches it drawn again in order. the result is a flat
+//list of DrawCommand for a backend to play, empty when nothing changed.
+//
+//the scene has no platform code and allocates nothing, the items and the command list are
+//fixed size arrays, and scores are formatted in place
+
+namespace ConnectFour
+{
+	struct SceneRect
+	{
+		float left = 0;
+		float top = 0;
+		float right = 0;
+		float bottom = 0;
+
+		friend constexpr bool operator==(const SceneRect& a, const SceneRect& b) noexcept = default;
+	};
+
+	[[nodiscard]]
+	constexpr bool Intersects(const SceneRect& a, const SceneRect& b) noexcept
+	{
+		return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+	}
+
+	[[nodiscard]]
+	constexpr SceneRect Union(const SceneRect& a, const SceneRect& b) noexcept
+	{
+		return
+		{
+			.left = a.left < b.left ? a.left : b.left,
+			.top = a.top < b.top ? a.top : b.top,
+			.right = a.right > b.right ? a.right : b.right,
+			.bottom = a.bottom > b.bottom ? a.bottom : b.bottom
+		};
+	}
+
+	//strictly inside, the edges belong to neither side
+	[[nodiscard]]
+	constexpr bool Contains(const SceneRect& rect, float x, float y) noexcept
+	{
+		return x > rect.left && x < rect.right && y > rect.top && y < rect.bottom;
+	}
+
+	enum class SceneBrush : uint8_t
+	{
+		Board = 0,
+		Player = 1,
+		CPU = 2,
+		Ghost = 3,
+		PlayerWin = 4,
+		CPUWin = 5
+	};
+
+	struct SceneColor
+	{
+		float r;
+		float g;
+		float b;
+	};
+
+	//indexed by SceneBrush, every backend draws in these
+	constexpr SceneColor SceneColors[] =
+	{
+		{ 1.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 1.0f, 0.0f, 0.0f },
+		{ .564f, .564f, .564f },
+		{ 0.5f, 0.5f, 1.0f },
+		{ 1.0f, 0.5f, 0.5f }
+	};
+
+	enum class DrawOp : uint8_t
+	{
+		//rect is the clip, aligned to whole pixels
+		PushClip = 0,
+		PopClip = 1,
+		//clears the current clip
+		Clear = 2,
+		FillRectangle = 3,
+		//rect bounds the ellipse
+		FillEllipse = 4,
+		//the board with its holes cut out, rect bounds it
+		FillBoard = 5,
+		//text centered in rect
+		Text = 6
+	};
+
+	constexpr int MaxSceneText = 12;
+
+	struct DrawCommand
+	{
+		DrawOp op = DrawOp::PopClip;
+		SceneBrush brush = SceneBrush::Board;
+		uint8_t textLength = 0;
+		SceneRect rect;
+		wchar_t text[MaxSceneText] = {};
+
+		friend constexpr bool operator==(const DrawCommand& a, const DrawCommand& b) noexcept = default;
+	};
+
+	struct ScenePoint
+	{
+		float x = 0;
+		float y = 0;
+	};
+
+	//where everything is for a window size and DPI, worked out once when either changes and
+	//then only read: the board is 80% of the window wide, the names and scores take the top
+	//fifth, and the menu is centered. the hit tests are a bounds check and a multiply
+	struct SceneLayout
+	{
+		float width = 0;
+		float height = 0;
+		unsigned dpi = 0;
+
+		float squareSize = 0;
+		SceneRect board;
+
+		//1 / squareSize, so the hover column is a multiply
+		float columnsPerPixel = 0;
+
+		//the holes cut out of the board, in cells indexed column * Height + row
+		float holeRadius = 0;
+		ScenePoint cellCenters[CellCount];
+
+		SceneRect youLabel;
+		SceneRect playerScore;
+		SceneRect cpuLabel;
+		SceneRect cpuScore;
+
+		//the menu's text areas, and the buttons' smaller areas that take the cursor
+		SceneRect title;
+		SceneRect playText;
+		SceneRect exitText;
+		SceneRect copyright;
+		SceneRect playButton;
+		SceneRect exitButton;
+
+		//text heights in pixels
+		float titleFontSize = 0;
+		float mainFontSize = 0;
+		float copyrightFontSize = 0;
+
+		[[nodiscard]]
+		static constexpr SceneLayout Compute(int windowWidth, int windowHeight, unsigned dpi = 96) noexcept
+		{
+			SceneLayout layout;
+
+			layout.width = (float)windowWidth;
+			layout.height = (float)windowHeight;
+			layout.dpi = dpi;
+
+			float boardMarginsHorizontal = layout.width * .1f;
+			float boardWidth = layout.width - boardMarginsHorizontal * 2;
+
+			layout.squareSize = boardWidth / Width;
+			layout.columnsPerPixel = Width / boardWidth;
+
+			float boardMarginTop = layout.width * .25f;
+
+			layout.board =
+			{
+				.left = boardMarginsHorizontal,
+				.top = boardMarginTop,
+				.right = boardMarginsHorizontal + boardWidth,
+				.bottom = boardMarginTop + layout.squareSize * Height
+			};
+
+			layout.holeRadius = (layout.squareSize / 2) * .8f;
+
+			for (int x = 0; x < Width; x++)
+			{
+				for (int y = 0; y < Height; y++)
+				{
+					layout.cellCenters[x * Height + y] =
+					{
+						.x = layout.board.left + layout.squareSize * x + layout.squareSize / 2,
+						.y = layout.board.top + layout.squareSize * y + layout.squareSize / 2
+					};
+				}
+			}
+
+			float scoreWidth = .2f * layout.width;
+			float scoreBottom = (.1f / .5f) * layout.height;
+			float middle = layout.width / 2;
+
+			layout.youLabel = { .left = 0, .top = 0, .right = middle - scoreWidth, .bottom = scoreBottom };
+			layout.playerScore = { .left = middle - scoreWidth, .top = 0, .right = middle, .bottom = scoreBottom };
+			layout.cpuScore = { .left = middle, .top = 0, .right = middle + scoreWidth, .bottom = scoreBottom };
+			layout.cpuLabel = { .left = middle + scoreWidth, .top = 0, .right = layout.width, .bottom = scoreBottom };
+
+			layout.title = { .left = 0, .top = layout.height * .1f, .right = layout.width, .bottom = layout.height * .8f };
+			layout.playText = { .left = 0, .top = layout.height * .3f, .right = layout.width, .bottom = layout.height * .8f };
+			layout.exitText = { .left = 0, .top = layout.height * .45f, .right = layout.width, .bottom = layout.height * .8f };
+			layout.copyright = { .left = 0, .top = layout.height * .9f, .right = layout.width, .bottom = layout.height };
+
+			layout.playButton = { .left = layout.width * .4f, .top = layout.height * .3f, .right = layout.width * .6f, .bottom = layout.height * .4f };
+			layout.exitButton = { .left = layout.width * .4f, .top = layout.height * .45f, .right = layout.width * .6f, .bottom = layout.height * .55f };
+
+			layout.titleFontSize = .12f * layout.height;
+			layout.mainFontSize = .08f * layout.height;
+			layout.copyrightFontSize = .05f * layout.height;
+
+			return layout;
+		}
+
+		//whether this is the layout for that window, so nothing needs working out again
+		[[nodiscard]]
+		constexpr bool Matches(int windowWidth, int windowHeight, unsigned windowDpi) const noexcept
+		{
+			return width == (float)windowWidth && height == (float)windowHeight && dpi == windowDpi;
+		}
+
+		//rows count down from the top of the board
+		[[nodiscard]]
+		constexpr SceneRect Cell(int column, int row) const noexcept
+		{
+			return
+			{
+				.left = board.left + squareSize * column,
+				.top = board.top + squareSize * row,
+				.right = board.left + squareSize * (column + 1),
+				.bottom = board.top + squareSize * (row + 1)
+			};
+		}
+
+		[[nodiscard]]
+		constexpr ScenePoint CellCenter(int column, int row) const noexcept
+		{
+			return cellCenters[column * Height + row];
+		}
+
+		//bounds of a loose piece centered on a row, which need not be whole or on the board
+		[[nodiscard]]
+		constexpr SceneRect Piece(int column, float row) const noexcept
+		{
+			float centerX = board.left + squareSize * column + squareSize / 2;
+			float centerY = board.top + squareSize * row + squareSize / 2;
+			float radius = (squareSize / 2) * .85f;
+
+			return
+			{
+				.left = centerX - radius,
+				.top = centerY - radius,
+				.right = centerX + radius,
+				.bottom = centerY + radius
+			};
+		}
+
+		//the column the cursor is over, -1 when it is beside the board
+		[[nodiscard]]
+		constexpr int ColumnAt(float x) const noexcept
+		{
+			if (!(x > board.left && x < board.right))
+				return -1;
+
+			int column = (int)((x - board.left) * columnsPerPixel);
+
+			//rounding can put the last pixel one column over
+			return column < Width ? column : Width - 1;
+		}
+
+		//the menu button the cursor is over
+		[[nodiscard]]
+		constexpr MenuButton ButtonAt(float x, float y) const noexcept
+		{
+			if (Contains(playButton, x, y))
+				return MenuButton::Play;
+
+			if (Contains(exitButton, x, y))
+				return MenuButton::Exit;
+
+			return MenuButton::None;
+		}
+	};
+
+	struct DrawList
+	{
+		static constexpr int ItemCount = 4 + CellCount + 2;
+
+		//regions beyond this are merged
+		static constexpr int MaxRegions = 4;
+
+		//each region is a clip, a clear, every item and the clip popped
+		static constexpr int Capacity = MaxRegions * (ItemCount + 3);
+
+		DrawCommand commands[Capacity];
+		int count = 0;
+	};
+
+	class Scene
+	{
+	public:
+		//the next Update() repaints everything, the target was lost or was drawn over
+		void Invalidate() noexcept
+		{
+			fullRedraw = true;
+		}
+
+		void Resize(int windowWidth, int windowHeight, unsigned dpi = 96) noexcept
+		{
+			layout = SceneLayout::Compute(windowWidth, windowHeight, dpi);
+			fullRedraw = true;
+		}
+
+		[[nodiscard]]
+		const SceneLayout& Layout() const noexcept
+		{
+			return layout;
+		}
+
+		//the commands that bring the last frame up to date with this one. hoverColumn is the
+		//column under the cursor, -1 when it is off the board
+		[[nodiscard]]
+		const DrawList& Update(const GameState& game, int hoverColumn) noexcept
+		{
+			DrawCommand next[DrawList::ItemCount];
+			BuildItems(game, hoverColumn, next);
+
+			regionCount = 0;
+
+			if (fullRedraw)
+			{
+				AddRegion({ .left = 0, .top = 0, .right = layout.width, .bottom = layout.height });
+				fullRedraw = false;
+			}
+			else
+			{
+				for (int i = 0; i < DrawList::ItemCount; i++)
+				{
+					if (next[i] == items[i])
+						continue;
+
+					if (items[i].op != DrawOp::PopClip)
+						AddRegion(items[i].rect);
+
+					if (next[i].op != DrawOp::PopClip)
+						AddRegion(next[i].rect);
+				}
+			}
+
+			for (int i = 0; i < DrawList::ItemCount; i++)
+				items[i] = next[i];
+
+			drawList.count = 0;
+
+			for (int region = 0; region < regionCount; region++)
+			{
+				Emit({ .op = DrawOp::PushClip, .rect = regions[region] });
+				Emit({ .op = DrawOp::Clear, .rect = regions[region] });
+
+				for (int i = 0; i < DrawList::ItemCount; i++)
+				{
+					if (items[i].op != DrawOp::PopClip && Intersects(items[i].rect, regions[region]))
+						Emit(items[i]);
+				}
+
+				Emit({ .op = DrawOp::PopClip, .rect = {} });
+			}
+
+			return drawList;
+		}
+
+	private:
+		SceneLayout layout;
+		bool fullRedraw = true;
+
+		//PopClip marks an item with nothing to draw
+		DrawCommand items[DrawList::ItemCount];
+
+		SceneRect regions[DrawList::MaxRegions];
+		int regionCount = 0;
+
+		DrawList drawList;
+
+		static constexpr int PlayerScoreItem = 1;
+		static constexpr int CPUScoreItem = 3;
+		static constexpr int FirstCellItem = 4;
+		static constexpr int LoosePieceItem = FirstCellItem + CellCount;
+		static constexpr int BoardItem = LoosePieceItem + 1;
+
+		static void SetText(DrawCommand& item, const wchar_t* text) noexcept
+		{
+			item.textLength = 0;
+
+			while (text[item.textLength] != 0 && item.textLength < MaxSceneText)
+			{
+				item.text[item.textLength] = text[item.textLength];
+				item.textLength++;
+			}
+		}
+
+		static void SetNumber(DrawCommand& item, int number) noexcept
+		{
+			wchar_t digits[MaxSceneText];
+			int digitCount = 0;
+
+			unsigned value = number < 0 ? 0u - (unsigned)number : (unsigned)number;
+
+			do
+			{
+				digits[digitCount++] = (wchar_t)(L'0' + value % 10);
+				value /= 10;
+			} while (value != 0 && digitCount < MaxSceneText - 1);
+
+			item.textLength = 0;
+
+			if (number < 0)
+				item.text[item.textLength++] = L'-';
+
+			while (digitCount > 0)
+				item.text[item.textLength++] = digits[--digitCount];
+		}
+
+		void BuildItems(const GameState& game, int hoverColumn, DrawCommand* next) const noexcept
+		{
+			next[0] = { .op = DrawOp::Text, .brush = SceneBrush::Player, .rect = layout.youLabel };
+			SetText(next[0], L"YOU");
+
+			next[PlayerScoreItem] = { .op = DrawOp::Text, .brush = SceneBrush::Player, .rect = layout.playerScore };
+			SetNumber(next[PlayerScoreItem], game.playerScore);
+
+			next[2] = { .op = DrawOp::Text, .brush = SceneBrush::CPU, .rect = layout.cpuLabel };
+			SetText(next[2], L"CPU");
+
+			next[CPUScoreItem] = { .op = DrawOp::Text, .brush = SceneBrush::CPU, .rect = layout.cpuScore };
+			SetNumber(next[CPUScoreItem], game.cpuScore);
+
+			Bitboard playerPieces = game.board.PlayerStones(0);
+			Bitboard occupied = game.board.Occupied();
+
+			for (int x = 0; x < Width; x++)
+			{
+				for (int y = 0; y < Height; y++)
+				{
+					Bitboard cell = CellBit(x, Height - 1 - y);
+					DrawCommand& item = next[FirstCellItem + x * Height + y];
+
+					if (!(occupied & cell))
+					{
+						item = {};
+						continue;
+					}
+
+					bool hilighted = game.highlightWinningPieces && (game.winningPieces & cell);
+
+					if (playerPieces & cell)
+						item = { .op = DrawOp::FillRectangle, .brush = hilighted ? SceneBrush::PlayerWin : SceneBrush::Player, .rect = {} };
+					else
+						item = { .op = DrawOp::FillRectangle, .brush = hilighted ? SceneBrush::CPUWin : SceneBrush::CPU, .rect = {} };
+
+					item.rect = layout.Cell(x, y);
+				}
+			}
+
+			DrawCommand& loosePiece = next[LoosePieceItem];
+
+			if (game.phase == GamePhase::PlayerTurn && hoverColumn >= 0 && hoverColumn < Width)
+				loosePiece = { .op = DrawOp::FillEllipse, .brush = SceneBrush::Player, .rect = layout.Piece(hoverColumn, -1) };
+			else if (game.phase == GamePhase::PieceFalling)
+				loosePiece = { .op = DrawOp::FillEllipse, .brush = game.fallingPiece == 1 ? SceneBrush::Player : SceneBrush::CPU, .rect = layout.Piece(game.fallingColumn, game.fallingRow) };
+			else
+				loosePiece = {};
+
+			next[BoardItem] = { .op = DrawOp::FillBoard, .brush = SceneBrush::Board, .rect = layout.board };
+		}
+
+		//out to whole pixels, so the repaint covers every pixel the old and the new item touched
+		//and the clip needs no antialiasing, merged with the first region it overlaps
+		void AddRegion(SceneRect rect) noexcept
+		{
+			rect.left = std::floor(rect.left) - 1;
+			rect.top = std::floor(rect.top) - 1;
+			rect.right = std::ceil(rect.right) + 1;
+			rect.bottom = std::ceil(rect.bottom) + 1;
+
+			for (int i = 0; i < regionCount; i++)
+			{
+				if (Intersects(regions[i], rect))
+				{
+					regions[i] = Union(regions[i], rect);
+					return;
+				}
+			}
+
+			if (regionCount < DrawList::MaxRegions)
+				regions[regionCount++] = rect;
+			else
+				regions[regionCount - 1] = Union(regions[regionCount - 1], rect);
+		}
+
+		void Emit(const DrawCommand& command) noexcept
+		{
+			drawList.commands[drawList.count++] = command;
+		}
+	};
+}
@@ -0,0 +1,742 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <climits>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+
+#include "ConnectFourCore.h"
+#include "ConnectFourTranspositionTable.h"
+#include "ConnectFourBook.h"
+#include "ConnectFourEval.h"
+
+//exact game theoretic solver, see ConnectFourCore.h for what scores mean
+//
+//what a solve costs on one core with a 64 MB table: a few milliseconds from 20 stones on, tens
+//of milliseconds from 12 stones, and tens of seconds and about 10^8 nodes from 4 or 5 stones.
+//the empty board is out of reach of search alone, so the game plays the first moves from the
+//opening book (ConnectFourBookGen.cpp) when it has one and otherwise from Search() against a
+//deadline, which always has a move within a frame
+
+namespace ConnectFour
+{
+	//columns searched middle out, center moves take part in the most lines
+	template<int BoardWidth>
+	constexpr auto BasicColumnOrder = []
+	{
+		struct { int columns[BoardWidth]; } order = {};
+
+		for (int i = 0; i < BoardWidth; i++)
+			order.columns[i] = BoardWidth / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+
+		return order;
+	}();
+
+	//same with the first two columns swapped, used to send helper threads down different branches
+	template<int BoardWidth>
+	constexpr auto BasicColumnOrderSwapped = []
+	{
+		auto order = BasicColumnOrder<BoardWidth>;
+
+		if constexpr (BoardWidth > 1)
+		{
+			order.columns[0] = BasicColumnOrder<BoardWidth>.columns[1];
+			order.columns[1] = BasicColumnOrder<BoardWidth>.columns[0];
+		}
+
+		return order;
+	}();
+
+	constexpr auto ColumnOrder = BasicColumnOrder<Width>;
+	constexpr auto ColumnOrderSwapped = BasicColumnOrderSwapped<Width>;
+
+	//limits for the anytime Search(), the clock is read every ClockCheckInterval nodes. max is
+	//parenthesized so the header survives Windows.h's max macro
+	struct SearchLimits
+	{
+		std::chrono::steady_clock::time_point deadline = (std::chrono::steady_clock::time_point::max)();
+		uint64_t nodeBudget = UINT64_MAX;
+		//plies, the search stops deepening after this many
+		int maxDepth = INT_MAX;
+	};
+
+	struct SearchResult
+	{
+		int column;
+		int score;
+		//plies searched by the last completed iteration, 0 if none completed in time
+		int depth;
+		//score is the real game theoretic score rather than a depth limited one
+		bool exact;
+	};
+
+	enum class MoveOrdering : uint8_t
+	{
+		//table move, threats, center distance, history and killers, see OrderMoves()
+		Full = 0,
+		//middle out and nothing else, kept to measure the full ordering against
+		CenterFirst = 1
+	};
+
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	class BasicSolver
+	{
+	public:
+		using Geometry = BoardGeometry<BoardWidth, BoardHeight, BoardConnect>;
+		using Position = BasicPosition<BoardWidth, BoardHeight, BoardConnect>;
+		using Bitboard = typename Geometry::Bitboard;
+		using EvalWeights = BasicEvalWeights<BoardWidth, BoardHeight, BoardConnect>;
+
+		static constexpr int Width = Geometry::Width;
+		static constexpr int CellCount = Geometry::CellCount;
+
+		//about 0.1 ms of search, the most a deadline can be overshot by before the search starts unwinding
+		static constexpr uint64_t ClockCheckInterval = 1024;
+
+		//rows 1, 3 and 5 counted from the bottom. a threat there is worth more to the first
+		//player, who gets to fill the odd cell of a column when the board runs out of moves,
+		//and a threat on the rows in between is worth more to the second player
+		static constexpr Bitboard OddRows = []
+		{
+			Bitboard rows = 0;
+			for (int x = 0; x < Width; x++)
+				for (int y = 0; y < BoardHeight; y += 2)
+					rows |= Geometry::CellBit(x, y);
+			return rows;
+		}();
+
+		static constexpr Bitboard EvenRows = Geometry::FullBoard ^ OddRows;
+
+		//the table can be shared with other solvers, including ones running on other threads.
+		//orderVariant 0 searches center first, other values perturb the order at some depths.
+		//once stop is set the search unwinds and returns meaningless scores
+		explicit BasicSolver(TranspositionTable& table, int orderVariant = 0, const std::atomic<bool>* stop = nullptr) noexcept :
+			table(table),
+			orderVariant(orderVariant),
+			stop(stop)
+		{
+			//no killers until something cuts off, a column 0 killer would favor the edge
+			for (auto& killer : killers)
+				killer[0] = killer[1] = -1;
+		}
+
+		//the exact score, by null window searches, see SolveNullWindow()
+		[[nodiscard]]
+		int Solve(const Position& position) noexcept
+		{
+			return SolveNullWindow(position);
+		}
+
+		//same score as Solve() from a single search with the full window of possible scores,
+		//kept to compare against: on the benchmark sets it searches a third more nodes
+		[[nodiscard]]
+		int SolveFullWindow(const Position& position) noexcept
+		{
+			if (position.CanWinNext())
+				return WinScore(position);
+
+			Position scratch = position;
+			return Negamax(scratch, -(CellCount - position.MoveCount()) / 2, (CellCount + 1 - position.MoveCount()) / 2, CellCount);
+		}
+
+		//the exact score, found by a binary search of null window searches. each one only has
+		//to prove the score is above or below a bound, which cuts off far more than a full
+		//window, and the first tries are biased toward 0 where most scores are
+		[[nodiscard]]
+		int SolveNullWindow(const Position& position) noexcept
+		{
+			if (position.CanWinNext())
+				return WinScore(position);
+
+			Position scratch = position;
+
+			int low = -(CellCount - position.MoveCount()) / 2;
+			int high = (CellCount + 1 - position.MoveCount()) / 2;
+
+			while (low < high && !Stopped())
+			{
+				int bound = low + (high - low) / 2;
+
+				if (bound <= 0 && low / 2 < bound)
+					bound = low / 2;
+				else if (bound >= 0 && high / 2 > bound)
+					bound = high / 2;
+
+				int score = Negamax(scratch, bound, bound + 1, CellCount);
+
+				if (score <= bound)
+					high = score;
+				else
+					low = score;
+			}
+
+			return low;
+		}
+
+		//only the sign of Solve(): 1 if the side to move wins, 0 for a draw and -1 if it loses.
+		//a single null window search around 0, much cheaper than the exact score
+		[[nodiscard]]
+		int SolveWeak(const Position& position) noexcept
+		{
+			if (position.CanWinNext())
+				return 1;
+
+			Position scratch = position;
+			int score = Negamax(scratch, -1, 1, CellCount);
+
+			return (score > 0) - (score < 0);
+		}
+
+		//iterative deepening until the score is exact or a limit is hit, always returns the
+		//move of the last completed iteration. the board must not be full
+		[[nodiscard]]
+		SearchResult Search(const Position& position, const SearchLimits& searchLimits) noexcept
+		{
+			limits = searchLimits;
+			limited = true;
+			limitHit = false;
+			nodeCountAtStart = nodeCount;
+
+			evaluating = evalWeights != nullptr;
+			if (evaluating)
+				evaluator.Refresh(position);
+
+			int remaining = CellCount - position.MoveCount();
+
+			//in case not even the first iteration finishes
+			Bitboard fallback = position.CanWinNext() ? 0 : position.PossibleNonLosingMoves();
+			if (fallback == 0)
+				fallback = position.PossibleMoves();
+
+			SearchResult result = { .column = -1, .score = 0, .depth = 0, .exact = false };
+
+			for (int i = 0; i < Width && result.column < 0; i++)
+			{
+				if (fallback & Geometry::ColumnMask(BasicColumnOrder<Width>.columns[i]))
+					result.column = BasicColumnOrder<Width>.columns[i];
+			}
+
+			int lastDepth = searchLimits.maxDepth < remaining ? searchLimits.maxDepth : remaining;
+
+			for (int depth = 1; depth <= lastDepth; depth++)
+			{
+				horizonReached = false;
+
+				int score;
+				int column = SearchRoot(position, depth, result.column, score);
+
+				if (Stopped())
+					break;
+
+				//an iteration that never stopped short of the end of the game is a full solve
+				result = { .column = column, .score = score, .depth = depth, .exact = !horizonReached };
+
+				if (result.exact)
+					break;
+			}
+
+			limited = false;
+			limitHit = false;
+			evaluating = false;
+
+			return result;
+		}
+
+		//column with the best score for the side to move, -1 when the board is full
+		[[nodiscard]]
+		int BestMove(const Position& position, int* scoreOut = nullptr) noexcept
+		{
+			int bestColumn = -1;
+			int bestScore = -CellCount;
+
+			const int* order = orderVariant % 2 ? BasicColumnOrderSwapped<Width>.columns : BasicColumnOrder<Width>.columns;
+
+			for (int i = 0; i < Width; i++)
+			{
+				int column = order[i];
+
+				if (!position.CanPlay(column))
+					continue;
+
+				int score;
+
+				if (position.IsWinningMove(column))
+				{
+					score = WinScore(position);
+				}
+				else
+				{
+					Position child = position;
+					child.Play(column);
+					score = child.IsFull() ? 0 : -Solve(child);
+				}
+
+				if (Stopped())
+					break;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestColumn = column;
+				}
+			}
+
+			if (scoreOut)
+				*scoreOut = bestScore;
+
+			return bestColumn;
+		}
+
+		//positions in the book are looked up instead of searched, the book has to outlive the solver
+		void UseBook(const OpeningBook* openingBook) noexcept
+		{
+			static_assert(std::is_same_v<Position, ConnectFour::Position>, "books are only made for the standard board");
+
+			book = openingBook;
+			bookMaxStones = book != nullptr && book->IsOpen() ? book->MaxStones() : -1;
+		}
+
+		void UseMoveOrdering(MoveOrdering moveOrdering) noexcept
+		{
+			ordering = moveOrdering;
+		}
+
+		//Search() scores positions at its horizon with these weights instead of as draws,
+		//nullptr goes back to draws. the weights have to outlive the solver
+		void UseEvaluation(const EvalWeights* weights) noexcept
+		{
+			evalWeights = weights;
+			evaluator.UseWeights(weights);
+		}
+
+		[[nodiscard]]
+		uint64_t NodeCount() const noexcept
+		{
+			return nodeCount;
+		}
+
+		[[nodiscard]]
+		const TableStats& TableStatistics() const noexcept
+		{
+			return tableStats;
+		}
+
+		[[nodiscard]]
+		bool Stopped() const noexcept
+		{
+			return limitHit || (stop != nullptr && stop->load(std::memory_order_relaxed));
+		}
+
+		void ResetNodeCount() noexcept
+		{
+			nodeCount = 0;
+			tableStats = {};
+		}
+
+	private:
+		//keys of up to 49 bits, the standard board's included, go into the table as they are and
+		//can never be confused with each other. longer keys are mixed down to 64 bits, so two
+		//positions could share an entry, but with the index and 40 bit tag to match that takes
+		//about 2^60 probes
+		[[nodiscard]]
+		static constexpr uint64_t TableKey(Bitboard key) noexcept
+		{
+			if constexpr (Geometry::KeyBits <= 49)
+			{
+				return key;
+			}
+			else
+			{
+				uint64_t hash;
+
+				if constexpr (std::is_same_v<Bitboard, Bitboard128>)
+					hash = key.low ^ (key.high * 0x9E3779B97F4A7C15);
+				else
+					hash = key;
+
+				//murmur3 finalizer, spreads every key bit over the whole word
+				hash ^= hash >> 33;
+				hash *= 0xFF51AFD7ED558CCD;
+				hash ^= hash >> 33;
+				hash *= 0xC4CEB9FE1A85EC53;
+				hash ^= hash >> 33;
+
+				return hash;
+			}
+		}
+
+		//searches preferredColumn first, then center first
+		int SearchRoot(const Position& position, int depth, int preferredColumn, int& bestScore) noexcept
+		{
+			int bestColumn = -1;
+			bestScore = -CellCount;
+
+			int alpha = -CellCount;
+			int beta = CellCount;
+
+			for (int i = -1; i < Width; i++)
+			{
+				int column = i < 0 ? preferredColumn : BasicColumnOrder<Width>.columns[i];
+
+				if (column < 0 || (i >= 0 && column == preferredColumn) || !position.CanPlay(column))
+					continue;
+
+				int score;
+
+				if (position.IsWinningMove(column))
+				{
+					//nothing beats winning right away
+					bestScore = WinScore(position);
+					return column;
+				}
+
+				Bitboard move = position.PossibleMoves() & Geometry::ColumnMask(column);
+				Position child = position;
+				child.Play(move);
+
+				if (child.IsFull())
+				{
+					score = 0;
+				}
+				else if (child.CanWinNext())
+				{
+					score = -WinScore(child);
+				}
+				else
+				{
+					if (evaluating)
+						evaluator.Play(move, position.MoveCount() & 1);
+
+					score = -Negamax(child, -beta, -alpha, depth - 1);
+
+					if (evaluating)
+						evaluator.Undo(move, position.MoveCount() & 1);
+				}
+
+				if (Stopped())
+					break;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestColumn = column;
+
+					if (score > alpha)
+						alpha = score;
+				}
+			}
+
+			return bestColumn;
+		}
+
+		struct MoveList
+		{
+			int columns[BoardWidth];
+			uint64_t scores[BoardWidth];
+			int count = 0;
+		};
+
+		//a history score past this halves every history score, so recent cutoffs count for
+		//more than old ones
+		static constexpr uint32_t HistoryLimit = 1 << 20;
+
+		//next holds the moves to search, all of them non-losing, so winning moves and forced
+		//blocks are already dealt with: Negamax() is never called with a win on the board, and
+		//a single threat leaves the block as the only move in next. the rest are sorted by
+		//
+		//  1. the table's best move for the position
+		//  2. most threats made, by counting the empty cells that would complete a line
+		//  3. most of those threats on the mover's good rows, odd for the first player and
+		//     even for the second
+		//  4. closest to the center
+		//  5. history, how often and how deep the move cut off before
+		//  6. killer moves, the two latest cutoffs at this many stones
+		//
+		//against MoveOrdering::CenterFirst this searches 3.5 to 3.9 times fewer nodes on the
+		//benchmark's 12 stone sets and 1.4 to 3.7 times fewer later on, nearly all of it from
+		//the threats. history and killers only pick between moves the static rules rank the
+		//same, placed any higher they made the search larger
+		void OrderMoves(const Position& position, Bitboard next, int tableMove, MoveList& moves) const noexcept
+		{
+			const int* order = BasicColumnOrder<Width>.columns;
+
+			if (orderVariant != 0 && (position.MoveCount() + orderVariant) % 3 == 0)
+				order = BasicColumnOrderSwapped<Width>.columns;
+
+			int side = position.MoveCount() & 1;
+			Bitboard goodRows = side == 0 ? OddRows : EvenRows;
+			const int8_t* killer = killers[position.MoveCount()];
+
+			for (int i = 0; i < Width; i++)
+			{
+				int column = order[i];
+				Bitboard move = next & Geometry::ColumnMask(column);
+
+				if (!move)
+					continue;
+
+				uint64_t score;
+
+				if (ordering == MoveOrdering::CenterFirst)
+				{
+					score = 0;
+				}
+				else if (column == tableMove)
+				{
+					score = UINT64_MAX;
+				}
+				else
+				{
+					Bitboard threats = Geometry::WinningSpots(position.CurrentStones() | move, position.Occupied() | move);
+					uint64_t threatScore = (uint64_t)PopCount(threats) * CellCount + PopCount(threats & goodRows);
+
+					int centerDistance = 2 * column - (Width - 1);
+					if (centerDistance < 0)
+						centerDistance = -centerDistance;
+
+					score = threatScore << 32 | (uint64_t)(2 * Width - centerDistance) << 24;
+					score |= (uint64_t)history[side][column * BoardHeight + position.ColumnHeight(column)] << 2;
+
+					if (column == killer[0])
+						score |= 2;
+					else if (column == killer[1])
+						score |= 1;
+				}
+
+				//after every move with at least the same score, so ties stay in the base order
+				int slot = moves.count++;
+
+				for (; slot > 0 && moves.scores[slot - 1] < score; slot--)
+				{
+					moves.columns[slot] = moves.columns[slot - 1];
+					moves.scores[slot] = moves.scores[slot - 1];
+				}
+
+				moves.columns[slot] = column;
+				moves.scores[slot] = score;
+			}
+		}
+
+		//column was good enough to cut the search off in position
+		void RecordCutoff(const Position& position, int column) noexcept
+		{
+			int8_t* killer = killers[position.MoveCount()];
+
+			if (killer[0] != column)
+			{
+				killer[1] = killer[0];
+				killer[0] = (int8_t)column;
+			}
+
+			int remaining = CellCount - position.MoveCount();
+			uint32_t& entry = history[position.MoveCount() & 1][column * BoardHeight + position.ColumnHeight(column)];
+
+			entry += (uint32_t)(remaining * remaining);
+
+			if (entry >= HistoryLimit)
+			{
+				for (auto& side : history)
+					for (uint32_t& score : side)
+						score /= 2;
+			}
+		}
+
+		[[nodiscard]]
+		bool LimitReached() const noexcept
+		{
+			return
+				nodeCount - nodeCountAtStart >= limits.nodeBudget ||
+				std::chrono::steady_clock::now() >= limits.deadline;
+		}
+
+		//the evaluation in solver units, kept within the scores the position can still have:
+		//the side to move can not win with its next stone and is not lost to the one after
+		[[nodiscard]]
+		int HorizonScore(const Position& position) const noexcept
+		{
+			int score = evaluator.Evaluate(position.MoveCount() & 1) / evaluator.Scale();
+
+			int lowest = -(CellCount - 2 - position.MoveCount()) / 2;
+			int highest = (CellCount - 1 - position.MoveCount()) / 2;
+
+			return score < lowest ? lowest : score > highest ? highest : score;
+		}
+
+		//side to move can not win with its next stone. depth is how many more plies to search,
+		//positions past it score 0, or by the evaluation in Search() when it has weights
+		int Negamax(Position& position, int alpha, int beta, int depth) noexcept
+		{
+			nodeCount++;
+
+			if (limited && nodeCount % ClockCheckInterval == 0 && LimitReached())
+				limitHit = true;
+
+			if (Stopped())
+				return 0;
+
+			if constexpr (std::is_same_v<Position, ConnectFour::Position>)
+			{
+				if (position.MoveCount() <= bookMaxStones)
+				{
+					int score;
+					if (book->Lookup(position, score))
+						return score;
+				}
+			}
+
+			Bitboard next = position.PossibleNonLosingMoves();
+
+			//every move loses, or a double threat can not be blocked
+			if (next == 0)
+				return -(CellCount - position.MoveCount()) / 2;
+
+			if (position.MoveCount() >= CellCount - 2)
+				return 0;
+
+			if (depth <= 0)
+			{
+				horizonReached = true;
+				return evaluating ? HorizonScore(position) : 0;
+			}
+
+			//the opponent can not win with their next stone, so the worst case is losing after that
+			int lowest = -(CellCount - 2 - position.MoveCount()) / 2;
+			if (alpha < lowest)
+			{
+				alpha = lowest;
+				if (alpha >= beta)
+					return alpha;
+			}
+
+			//we can not win with this stone, so the best case is winning with the next one
+			int highest = (CellCount - 1 - position.MoveCount()) / 2;
+
+			//a search that reaches the end of the game is exact, whatever depth it was given
+			int remaining = CellCount - position.MoveCount();
+			int searchDepth = depth < remaining ? depth : remaining;
+
+			Bitboard canonicalKey = position.CanonicalKey();
+			bool mirrored = canonicalKey != position.Key();
+			uint64_t key = TableKey(canonicalKey);
+			TableEntry entry;
+			bool found = table.Probe(key, entry, tableStats);
+
+			if (found && entry.depth >= searchDepth)
+			{
+				//the entry's search may have stopped at a horizon of its own
+				if (entry.depth < remaining)
+					horizonReached = true;
+
+				if (entry.bound == Bound::Upper || entry.bound == Bound::Exact)
+				{
+					if (entry.score < highest)
+						highest = entry.score;
+				}
+
+				if (entry.bound == Bound::Lower || entry.bound == Bound::Exact)
+				{
+					if (entry.score > alpha)
+					{
+						alpha = entry.score;
+						if (alpha >= beta)
+							return alpha;
+					}
+				}
+			}
+
+			if (beta > highest)
+			{
+				beta = highest;
+				if (alpha >= beta)
+					return beta;
+			}
+
+			int originalAlpha = alpha;
+			int bestMove = NoMove;
+
+			int tableMove = NoMove;
+			if (found && entry.bestMove != NoMove)
+				tableMove = mirrored ? Width - 1 - entry.bestMove : entry.bestMove;
+
+			MoveList moves;
+			OrderMoves(position, next, tableMove, moves);
+
+			for (int i = 0; i < moves.count; i++)
+			{
+				int column = moves.columns[i];
+				Bitboard move = next & Geometry::ColumnMask(column);
+
+				if (evaluating)
+					evaluator.Play(move, position.MoveCount() & 1);
+
+				position.Play(move);
+				int score = -Negamax(position, -beta, -alpha, depth - 1);
+				position.Undo(move);
+
+				if (evaluating)
+					evaluator.Undo(move, position.MoveCount() & 1);
+
+				//the child was cut short, its score can not be trusted or stored
+				if (Stopped())
+					return 0;
+
+				if (score >= beta)
+				{
+					RecordCutoff(position, column);
+					table.Store(key, score, Bound::Lower, mirrored ? Width - 1 - column : column, searchDepth, tableStats);
+					return score;
+				}
+
+				if (score > alpha)
+				{
+					alpha = score;
+					bestMove = column;
+				}
+			}
+
+			if (mirrored && bestMove != NoMove)
+				bestMove = Width - 1 - bestMove;
+
+			table.Store(key, alpha, alpha > originalAlpha ? Bound::Exact : Bound::Upper, bestMove, searchDepth, tableStats);
+
+			return alpha;
+		}
+
+		TranspositionTable& table;
+		int orderVariant;
+		const std::atomic<bool>* stop;
+
+		const OpeningBook* book = nullptr;
+		int bookMaxStones = -1;
+
+		uint64_t nodeCount = 0;
+		TableStats tableStats = {};
+
+		SearchLimits limits = {};
+		bool limited = false;
+		bool limitHit = false;
+		uint64_t nodeCountAtStart = 0;
+		//set when the current iteration scored a position at the horizon instead of searching on
+		bool horizonReached = false;
+
+		//the evaluator follows every move only while Search() runs with weights
+		const EvalWeights* evalWeights = nullptr;
+		BasicEvaluator<BoardWidth, BoardHeight, BoardConnect> evaluator;
+		bool evaluating = false;
+
+		//move ordering, see OrderMoves()
+		MoveOrdering ordering = MoveOrdering::Full;
+		//-1 is no move
+		int8_t killers[CellCount][2];
+		uint32_t history[2][CellCount] = {};
+	};
+
+	using Solver = BasicSolver<Width, Height, Connect>;
+}
@@ -0,0 +1,282 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "ConnectFourCore.h"
+#include "ConnectFourMappedFile.h"
+
+//win, draw or loss for every position of a small board, written by ConnectFourRetrograde.cpp
+//
+//file layout, little endian, every section a whole number of uint64_t:
+//
+//  StrongTableHeader
+//  uint64_t levelWords[levelCount]          size of each hash level in words
+//  uint64_t hashBits[hashWords]             the levels, one after another
+//  uint64_t rankCounts[hashWords / 8 + 1]   set bits in hashBits before each 8 word block
+//  uint64_t outcomes[positionCount / 32 + 1]   2 bits per position, an Outcome
+//
+//positions are indexed by a minimal perfect hash of their canonical key (BBHash): a key
+//is hashed into level 0, and if that bit is not set, into level 1 and so on. the index of
+//a key is the number of set bits before the one it lands on, so every stored position has
+//its own slot with no keys kept in the file. a key that was never stored, a position
+//with four in a row on the board, lands on some other position's slot or on none at all;
+//Lookup() rules out the first kind, every other position can be reached in play
+
+namespace ConnectFour
+{
+	//from the point of view of the side to move
+	enum class Outcome : uint8_t
+	{
+		Unknown = 0,
+		Loss = 1,
+		Draw = 2,
+		Win = 3
+	};
+
+	//the same outcome for the other player
+	[[nodiscard]]
+	constexpr Outcome FlipOutcome(Outcome outcome) noexcept
+	{
+		switch (outcome)
+		{
+		case Outcome::Win:
+			return Outcome::Loss;
+		case Outcome::Loss:
+			return Outcome::Win;
+		default:
+			return outcome;
+		}
+	}
+
+	struct StrongTableHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint8_t width;
+		uint8_t height;
+		uint8_t connect;
+		uint8_t levelCount;
+		uint32_t reserved;
+		uint64_t positionCount;
+		uint64_t hashWords;
+	};
+
+	static_assert(sizeof(StrongTableHeader) == 32);
+
+	constexpr char StrongTableMagic[4] = { 'C', '4', 'S', 'T' };
+	constexpr uint32_t StrongTableVersion = 1;
+	constexpr int MaxHashLevels = 64;
+
+	//the hash of a key for one level of the table
+	[[nodiscard]]
+	constexpr uint64_t PerfectHashMix(uint64_t key, int level) noexcept
+	{
+		key += (uint64_t)(level + 1) * 0x9E3779B97F4A7C15ull;
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDull;
+		key ^= key >> 33;
+		key *= 0xC4CEB9FE1A85EC53ull;
+		key ^= key >> 33;
+		return key;
+	}
+
+	//minimal perfect hash laid out as in the file, used by the table and by the tool
+	//that builds it
+	struct PerfectHash
+	{
+		int levelCount = 0;
+		uint64_t keyCount = 0;
+		const uint64_t* levelWords = nullptr;
+		const uint64_t* hashBits = nullptr;
+		const uint64_t* rankCounts = nullptr;
+
+		//index is below keyCount for every key the hash was built from, false for some of
+		//the other keys
+		[[nodiscard]]
+		bool Index(uint64_t key, uint64_t& index) const noexcept
+		{
+			uint64_t levelStart = 0;
+
+			for (int level = 0; level < levelCount; level++)
+			{
+				uint64_t bit = levelStart * 64 + PerfectHashMix(key, level) % (levelWords[level] * 64);
+				uint64_t word = bit / 64;
+				uint64_t select = 1ull << (bit % 64);
+
+				if (hashBits[word] & select)
+				{
+					index = rankCounts[word / 8];
+
+					for (uint64_t i = word / 8 * 8; i < word; i++)
+						index += PopCount(hashBits[i]);
+
+					index += PopCount(hashBits[word] & (select - 1));
+					return index < keyCount;
+				}
+
+				levelStart += levelWords[level];
+			}
+
+			return false;
+		}
+	};
+
+	template<int BoardWidth, int BoardHeight, int BoardConnect>
+	class BasicStrongTable
+	{
+	public:
+		using PositionType = BasicPosition<BoardWidth, BoardHeight, BoardConnect>;
+		using Geometry = typename PositionType::Geometry;
+
+		static_assert(Geometry::KeyBits <= 64, "strong tables are for boards whose keys fit in 64 bits");
+
+		BasicStrongTable() noexcept = default;
+
+		BasicStrongTable(const BasicStrongTable&) = delete;
+		BasicStrongTable& operator=(const BasicStrongTable&) = delete;
+
+		//false if the file is missing or is not a table for this board
+		[[nodiscard]]
+		bool Open(const char* path) noexcept
+		{
+			Close();
+
+			if (!file.Open(path, MappedFile::Access::Random))
+				return false;
+
+			const StrongTableHeader* header = (const StrongTableHeader*)file.Data();
+
+			if (file.Size() < sizeof(StrongTableHeader) ||
+				memcmp(header->magic, StrongTableMagic, sizeof(StrongTableMagic)) != 0 ||
+				header->version != StrongTableVersion ||
+				header->width != BoardWidth ||
+				header->height != BoardHeight ||
+				header->connect != BoardConnect ||
+				header->levelCount > MaxHashLevels)
+			{
+				Close();
+				return false;
+			}
+
+			const uint64_t* words = (const uint64_t*)(file.Data() + sizeof(StrongTableHeader));
+			uint64_t wordCount = (file.Size() - sizeof(StrongTableHeader)) / sizeof(uint64_t);
+
+			uint64_t needed = header->levelCount + header->hashWords + (header->hashWords / 8 + 1) + (header->positionCount / 32 + 1);
+
+			if (header->hashWords > wordCount || header->positionCount > wordCount * 32 || needed > wordCount)
+			{
+				Close();
+				return false;
+			}
+
+			hash.levelCount = header->levelCount;
+			hash.keyCount = header->positionCount;
+			hash.levelWords = words;
+			hash.hashBits = hash.levelWords + hash.levelCount;
+			hash.rankCounts = hash.hashBits + header->hashWords;
+			outcomes = hash.rankCounts + (header->hashWords / 8 + 1);
+
+			return true;
+		}
+
+		void Close() noexcept
+		{
+			file.Close();
+
+			hash = {};
+			outcomes = nullptr;
+		}
+
+		[[nodiscard]]
+		bool IsOpen() const noexcept
+		{
+			return outcomes != nullptr;
+		}
+
+		//positions in the table, one of each mirrored pair
+		[[nodiscard]]
+		uint64_t PositionCount() const noexcept
+		{
+			return hash.keyCount;
+		}
+
+		//Unknown for a game that is already over, or with no table open
+		[[nodiscard]]
+		Outcome Lookup(const PositionType& position) const noexcept
+		{
+			if (!IsOpen() ||
+				Geometry::HasAlignment(position.CurrentStones()) ||
+				Geometry::HasAlignment(position.OpponentStones()))
+			{
+				return Outcome::Unknown;
+			}
+
+			uint64_t index;
+
+			if (!hash.Index((uint64_t)position.CanonicalKey(), index))
+				return Outcome::Unknown;
+
+			return (Outcome)((outcomes[index / 32] >> (2 * (index % 32))) & 3);
+		}
+
+		//a move keeping the best outcome, an immediate win before anything else.
+		//false if the position is not in the table or has no moves
+		[[nodiscard]]
+		bool BestMove(const PositionType& position, int& column, Outcome* outcomeOut = nullptr) const noexcept
+		{
+			if (Lookup(position) == Outcome::Unknown)
+				return false;
+
+			int best = -1;
+			Outcome bestOutcome = Outcome::Unknown;
+
+			for (int x = 0; x < BoardWidth; x++)
+			{
+				if (!position.CanPlay(x))
+					continue;
+
+				if (position.IsWinningMove(x))
+				{
+					best = x;
+					bestOutcome = Outcome::Win;
+					break;
+				}
+
+				PositionType child = position;
+				child.Play(x);
+
+				//the child's outcome is for the opponent
+				Outcome outcome = FlipOutcome(Lookup(child));
+
+				if (best < 0 || (uint8_t)outcome > (uint8_t)bestOutcome)
+				{
+					best = x;
+					bestOutcome = outcome;
+				}
+			}
+
+			if (best < 0)
+				return false;
+
+			column = best;
+
+			if (outcomeOut != nullptr)
+				*outcomeOut = bestOutcome;
+
+			return true;
+		}
+
+	private:
+		MappedFile file;
+
+		PerfectHash hash;
+		const uint64_t* outcomes = nullptr;
+	};
+}
@@ -0,0 +1,199 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//renders the final position of every game in a record file to an image
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourThumbnails.cpp -o ConnectFourThumbnails
+//usage: ConnectFourThumbnails [-threads N] [-size N] [-ppm] [-o DIR] FILE
+//
+//the records are split over the threads like ConnectFourReplay does, each thread replays its
+//games and renders them with one shared BoardRasterizer, winning lines highlighted, into
+//DIR/NNNNNNNN.png (or .ppm), numbered by the game's place in the file. without -o the images
+//are rendered and encoded but not written, which measures the renderer alone
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourRaster.h"
+
+using namespace ConnectFour;
+
+struct ThumbnailTotals
+{
+	uint64_t images = 0;
+	uint64_t bytes = 0;
+	uint64_t invalid = 0;
+	uint64_t unwritten = 0;
+};
+
+struct ThumbnailJob
+{
+	const BoardRasterizer* rasterizer;
+	bool ppm;
+	const char* directory;
+};
+
+static void RenderRecords(RecordCursor cursor, uint64_t firstGame, const ThumbnailJob& job, ThumbnailTotals& totals)
+{
+	std::vector<uint8_t> pixels(job.rasterizer->PixelCount());
+	ImageEncoder encoder;
+
+	GameRecord record;
+	Position position;
+	char path[4096];
+
+	for (uint64_t game = firstGame; cursor.Next(record); game++)
+	{
+		if (!ReplayGame(record, position))
+		{
+			totals.invalid++;
+			continue;
+		}
+
+		//a win can only be completed by the last move
+		Bitboard highlighted = 0;
+
+		if (record.result == GameResult::FirstPlayerWin || record.result == GameResult::SecondPlayerWin)
+		{
+			int last = record.moves[record.moveCount - 1];
+			highlighted = WinningLinesThrough(position.OpponentStones(), CellIndex(last, position.ColumnHeight(last) - 1));
+		}
+
+		job.rasterizer->Render(position, highlighted, pixels.data());
+
+		int width = job.rasterizer->ImageWidth();
+		int height = job.rasterizer->ImageHeight();
+		const uint8_t* palette = job.rasterizer->Palette();
+
+		const std::vector<uint8_t>& image = job.ppm ?
+			encoder.PPM(pixels.data(), width, height, palette) :
+			encoder.PNG(pixels.data(), width, height, palette, BoardRasterizer::PaletteSize);
+
+		totals.images++;
+		totals.bytes += image.size();
+
+		if (job.directory == nullptr)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%08llu.%s", job.directory, (unsigned long long)game, job.ppm ? "ppm" : "png");
+
+		FILE* file = fopen(path, "wb");
+
+		if (file == nullptr || fwrite(image.data(), 1, image.size(), file) != image.size())
+			totals.unwritten++;
+
+		if (file != nullptr && fclose(file) != 0)
+			totals.unwritten++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int threadCount = (int)std::thread::hardware_concurrency();
+	int size = 128;
+	bool ppm = false;
+	const char* directory = nullptr;
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+			size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-ppm") == 0)
+			ppm = true;
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			directory = argv[++i];
+		else if (argv[i][0] != '-' && path == nullptr)
+			path = argv[i];
+		else
+		{
+			path = nullptr;
+			break;
+		}
+	}
+
+	if (path == nullptr || size < 16 || size > 4096)
+	{
+		fprintf(stderr, "usage: %s [-threads N] [-size N] [-ppm] [-o DIR] FILE\n", argv[0]);
+		fprintf(stderr, "       -size is the image width and height, 16 to 4096, 128 by default\n");
+		return EXIT_FAILURE;
+	}
+
+	GameArchive archive;
+
+	if (!archive.Open(path))
+	{
+		fprintf(stderr, "unable to open %s, or it is not a %dx%d game record file\n", path, Width, Height);
+		return EXIT_FAILURE;
+	}
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	BoardRasterizer rasterizer(size, size);
+
+	double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+
+	std::vector<RecordCursor> parts = archive.SplitRecords(threadCount);
+	std::vector<ThumbnailTotals> results(parts.size());
+
+	//images are numbered by their place in the file, so every part needs its first number
+	std::vector<uint64_t> firstGames(parts.size());
+	uint64_t games = 0;
+
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		firstGames[i] = games;
+
+		RecordCursor cursor = parts[i];
+		GameRecord record;
+
+		while (cursor.Next(record))
+			games++;
+	}
+
+	ThumbnailJob job = { .rasterizer = &rasterizer, .ppm = ppm, .directory = directory };
+
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < parts.size(); i++)
+		helpers.emplace_back(RenderRecords, parts[i], firstGames[i], std::cref(job), std::ref(results[i]));
+
+	if (!parts.empty())
+		RenderRecords(parts[0], firstGames[0], job, results[0]);
+
+	for (std::thread& helper : helpers)
+		helper.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ThumbnailTotals total;
+
+	for (const ThumbnailTotals& part : results)
+	{
+		total.images += part.images;
+		total.bytes += part.bytes;
+		total.invalid += part.invalid;
+		total.unwritten += part.unwritten;
+	}
+
+	printf("%llu %dx%d %s images in %.3f s on %zu threads, %.3f s setup\n",
+		(unsigned long long)total.images, size, size, ppm ? "PPM" : "PNG", seconds, parts.size(), setupSeconds);
+	printf("%.0f images/s, %.0f bytes an image\n", total.images / seconds, total.images ? (double)total.bytes / total.images : 0.0);
+	printf("invalid %llu, unwritten %llu\n", (unsigned long long)total.invalid, (unsigned long long)total.unwritten);
+
+	return total.invalid == 0 && total.unwritten == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,403 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//headless self-play tournament between two agents
+//
+//build: g++ -std=c++20 -O2 -march=native -pthread ConnectFourTournament.cpp -o ConnectFourTournament
+//usage: ConnectFourTournament [-a AGENT] [-b AGENT] [-games N] [-threads N] [-opening N] [-hash MB] [-book FILE] [-eval FILE] [-seed N] [-record FILE]
+//
+//agents:
+//  random      any playable column, the game's original CPU player
+//  greedy      wins when it can, otherwise a random move that does not lose at once, the
+//              MCTS playout policy
+//  depth:N     iterative deepening search to N plies
+//  search:MS   iterative deepening search stopped after MS milliseconds, like the game
+//  evaldepth:N, evalsearch:MS
+//              the same, scoring positions at the horizon with ConnectFourEval.h rather than
+//              as draws, with the built in weights or those of -eval
+//  solver      exact solve of every move, needs a book or a long opening to finish quickly
+//  mcts:N      monte carlo tree search with N playouts per move
+//
+//games are played in pairs from the same random opening of -opening plies, each agent
+//taking the first move once, and spread over all threads. every thread has its own
+//agents, tables included. prints games/sec, A's results with a 95% confidence interval
+//and per move latency. -record appends every game, opening included, to a game record file
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ConnectFourSolver.h"
+#include "ConnectFourMCTS.h"
+#include "ConnectFourRecord.h"
+
+using namespace ConnectFour;
+
+enum class AgentKind
+{
+	Random,
+	Greedy,
+	Depth,
+	Search,
+	Solver,
+	MCTS
+};
+
+struct AgentSpec
+{
+	AgentKind kind;
+	int parameter;
+	//depth and search agents score their horizon with the evaluation instead of as a draw
+	bool evaluate;
+};
+
+[[nodiscard]]
+static bool ParseAgent(const char* text, AgentSpec& spec) noexcept
+{
+	const char* colon = strchr(text, ':');
+	size_t nameLength = colon ? (size_t)(colon - text) : strlen(text);
+	int parameter = colon ? atoi(colon + 1) : 0;
+
+	spec = { .kind = AgentKind::Random, .parameter = parameter, .evaluate = false };
+
+	if (nameLength > 4 && strncmp(text, "eval", 4) == 0)
+	{
+		spec.evaluate = true;
+		text += 4;
+		nameLength -= 4;
+	}
+
+	if (nameLength == 6 && strncmp(text, "random", 6) == 0)
+		spec.kind = AgentKind::Random;
+	else if (nameLength == 6 && strncmp(text, "greedy", 6) == 0)
+		spec.kind = AgentKind::Greedy;
+	else if (nameLength == 6 && strncmp(text, "solver", 6) == 0)
+		spec.kind = AgentKind::Solver;
+	else if (nameLength == 5 && strncmp(text, "depth", 5) == 0 && parameter > 0)
+		spec.kind = AgentKind::Depth;
+	else if (nameLength == 6 && strncmp(text, "search", 6) == 0 && parameter > 0)
+		spec.kind = AgentKind::Search;
+	else if (nameLength == 4 && strncmp(text, "mcts", 4) == 0 && parameter > 0)
+		spec.kind = AgentKind::MCTS;
+	else
+		return false;
+
+	if (spec.evaluate && spec.kind != AgentKind::Depth && spec.kind != AgentKind::Search)
+		return false;
+
+	return true;
+}
+
+class Agent
+{
+public:
+	//agents that do not search get the smallest table there is
+	Agent(const AgentSpec& spec, size_t tableBytes, const OpeningBook* book, const EvalWeights* evalWeights, uint64_t seed) noexcept :
+		spec(spec),
+		table(spec.kind == AgentKind::Depth || spec.kind == AgentKind::Search || spec.kind == AgentKind::Solver ? tableBytes : 0),
+		solver(table),
+		mcts(seed),
+		rng(seed)
+	{
+		solver.UseBook(book);
+
+		if (spec.evaluate)
+			solver.UseEvaluation(evalWeights);
+	}
+
+	[[nodiscard]]
+	int Move(const Position& position)
+	{
+		switch (spec.kind)
+		{
+		case AgentKind::Depth:
+			return solver.Search(position, { .maxDepth = spec.parameter }).column;
+		case AgentKind::Search:
+			return solver.Search(position, { .deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(spec.parameter) }).column;
+		case AgentKind::Solver:
+			return solver.BestMove(position);
+		case AgentKind::MCTS:
+			return mcts.BestMove(position, spec.parameter);
+		case AgentKind::Greedy:
+			return RolloutMove(position, rng);
+		default:
+			return RandomMove(position, rng);
+		}
+	}
+
+private:
+	AgentSpec spec;
+	TranspositionTable table;
+	Solver solver;
+	MCTS mcts;
+	std::mt19937_64 rng;
+};
+
+struct ThreadResults
+{
+	int wins = 0;
+	int draws = 0;
+	int losses = 0;
+	//microseconds per move, for agent A and B
+	std::vector<double> latency[2];
+	//encoded games, only kept with -record
+	std::vector<uint8_t> records;
+};
+
+//1 if the first player wins, -1 if the second player wins, 0 for a draw
+//record holds the opening that led to position and gets the rest of the game
+[[nodiscard]]
+static int PlayGame(Position position, Agent* players[2], std::vector<double>* latency[2], GameRecord& record)
+{
+	while (!position.IsFull())
+	{
+		int side = position.MoveCount() % 2;
+
+		auto start = std::chrono::steady_clock::now();
+		int column = players[side]->Move(position);
+		latency[side]->push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+		record.moves[record.moveCount++] = (uint8_t)column;
+
+		if (position.IsWinningMove(column))
+		{
+			record.result = side == 0 ? GameResult::FirstPlayerWin : GameResult::SecondPlayerWin;
+			return side == 0 ? 1 : -1;
+		}
+
+		position.Play(column);
+	}
+
+	record.result = GameResult::Draw;
+	return 0;
+}
+
+//random moves that neither win nor fill the board
+[[nodiscard]]
+static Position RandomOpening(std::mt19937_64& rng, int plies, GameRecord& record) noexcept
+{
+	Position position;
+	record = {};
+
+	while (position.MoveCount() < plies && !position.CanWinNext() && position.MoveCount() + 1 < CellCount)
+	{
+		int column = RolloutMove(position, rng);
+		record.moves[record.moveCount++] = (uint8_t)column;
+		position.Play(column);
+	}
+
+	return position;
+}
+
+static void PrintLatency(const char* name, std::vector<double>& latency) noexcept
+{
+	if (latency.empty())
+		return;
+
+	std::sort(latency.begin(), latency.end());
+
+	double total = 0;
+	for (double microseconds : latency)
+		total += microseconds;
+
+	printf("%-16s %10zu %12.1f %12.1f %12.1f %12.1f\n", name, latency.size(),
+		total / latency.size(), latency[latency.size() / 2], latency[latency.size() * 99 / 100], latency.back());
+}
+
+int main(int argc, char** argv)
+{
+	AgentSpec specs[2] = {};
+	const char* agentText[2] = { "search:15", "random" };
+	int gameCount = 100;
+	int threadCount = (int)std::thread::hardware_concurrency();
+	int openingPlies = 4;
+	size_t hashMegabytes = 16;
+	const char* bookPath = nullptr;
+	const char* evalPath = nullptr;
+	uint64_t seed = 1;
+	const char* recordPath = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+			agentText[0] = argv[++i];
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			agentText[1] = argv[++i];
+		else if (strcmp(argv[i], "-games") == 0 && i + 1 < argc)
+			gameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-opening") == 0 && i + 1 < argc)
+			openingPlies = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-book") == 0 && i + 1 < argc)
+			bookPath = argv[++i];
+		else if (strcmp(argv[i], "-eval") == 0 && i + 1 < argc)
+			evalPath = argv[++i];
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-a AGENT] [-b AGENT] [-games N] [-threads N] [-opening N] [-hash MB] [-book FILE] [-eval FILE] [-seed N] [-record FILE]\n", argv[0]);
+			fprintf(stderr, "agents: random, greedy, depth:N, search:MS, evaldepth:N, evalsearch:MS, solver, mcts:N\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!ParseAgent(agentText[i], specs[i]))
+		{
+			fprintf(stderr, "unknown agent: %s\n", agentText[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	if (gameCount < 1)
+		gameCount = 1;
+
+	OpeningBook book;
+
+	if (bookPath != nullptr && !book.Open(bookPath))
+	{
+		fprintf(stderr, "unable to open book %s\n", bookPath);
+		return EXIT_FAILURE;
+	}
+
+	EvalWeights evalWeights = EvalWeights::Default();
+
+	if (evalPath != nullptr && !evalWeights.Load(evalPath))
+	{
+		fprintf(stderr, "unable to open evaluation weights %s\n", evalPath);
+		return EXIT_FAILURE;
+	}
+
+	GameWriter writer;
+
+	if (recordPath != nullptr && !writer.Open(recordPath))
+	{
+		fprintf(stderr, "unable to open record file %s\n", recordPath);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<ThreadResults> results(threadCount);
+	std::atomic<int> nextGame = 0;
+
+	auto worker = [&](int index)
+	{
+		Agent a(specs[0], hashMegabytes << 20, &book, &evalWeights, seed * 2 + index * 1000003);
+		Agent b(specs[1], hashMegabytes << 20, &book, &evalWeights, seed * 2 + index * 1000003 + 1);
+		ThreadResults& threadResults = results[index];
+
+		for (int game = nextGame++; game < gameCount; game = nextGame++)
+		{
+			//both games of a pair start from the same opening
+			std::mt19937_64 rng(seed * 1000003 + game / 2);
+			GameRecord record;
+			Position opening = RandomOpening(rng, openingPlies, record);
+
+			//A has the first player's stones in even games, the opening counts as their moves
+			bool aFirst = game % 2 == 0;
+
+			Agent* players[2] = { aFirst ? &a : &b, aFirst ? &b : &a };
+			std::vector<double>* latency[2] = { &threadResults.latency[aFirst ? 0 : 1], &threadResults.latency[aFirst ? 1 : 0] };
+
+			int result = PlayGame(opening, players, latency, record);
+
+			if (recordPath != nullptr)
+			{
+				uint8_t encoded[MaxRecordBytes];
+				size_t size = EncodeGame(record, encoded);
+				threadResults.records.insert(threadResults.records.end(), encoded, encoded + size);
+			}
+
+			if (!aFirst)
+				result = -result;
+
+			if (result > 0)
+				threadResults.wins++;
+			else if (result < 0)
+				threadResults.losses++;
+			else
+				threadResults.draws++;
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> helpers;
+	for (int i = 1; i < threadCount; i++)
+		helpers.emplace_back(worker, i);
+
+	worker(0);
+
+	for (std::thread& helper : helpers)
+		helper.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ThreadResults total;
+
+	for (ThreadResults& threadResults : results)
+	{
+		total.wins += threadResults.wins;
+		total.draws += threadResults.draws;
+		total.losses += threadResults.losses;
+
+		for (int i = 0; i < 2; i++)
+			total.latency[i].insert(total.latency[i].end(), threadResults.latency[i].begin(), threadResults.latency[i].end());
+
+		if (recordPath != nullptr && !writer.Write(threadResults.records.data(), threadResults.records.size()))
+		{
+			fprintf(stderr, "unable to write %s\n", recordPath);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!writer.Close())
+	{
+		fprintf(stderr, "unable to write %s\n", recordPath);
+		return EXIT_FAILURE;
+	}
+
+	//normal approximation, good enough from a few dozen games on
+	double games = gameCount;
+	double score = (total.wins + total.draws * 0.5) / games;
+	double variance = (total.wins * (1 - score) * (1 - score) + total.draws * (0.5 - score) * (0.5 - score) + total.losses * score * score) / games;
+	double margin = 1.96 * std::sqrt(variance / games);
+
+	printf("A: %s  B: %s  opening: %d plies\n", agentText[0], agentText[1], openingPlies);
+	printf("%d games in %.2f s on %d threads, %.2f games/s\n", gameCount, seconds, threadCount, games / seconds);
+	printf("A wins %d, draws %d, losses %d\n", total.wins, total.draws, total.losses);
+	printf("A score %.3f +- %.3f (95%%)\n", score, margin);
+
+	//elo difference is unbounded at a score of 0 or 1
+	auto Elo = [](double s) { return -400 * std::log10(1 / s - 1); };
+	double low = score - margin;
+	double high = score + margin;
+
+	if (low > 0 && high < 1)
+		printf("A elo difference %+.0f [%+.0f, %+.0f]\n", Elo(score), Elo(low), Elo(high));
+
+	printf("\n%-16s %10s %12s %12s %12s %12s\n", "move latency", "moves", "mean us", "p50 us", "p99 us", "max us");
+	PrintLatency(agentText[0], total.latency[0]);
+	PrintLatency(agentText[1], total.latency[1]);
+
+	return EXIT_SUCCESS;
+}
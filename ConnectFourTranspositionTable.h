@@ -0,0 +1,336 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "ConnectFourCore.h"
+
+//fixed size transposition table
+//
+//the table is one allocation of 64 byte buckets made at startup and never grown,
+//so the budget passed to the constructor is what the search engine uses.
+//every bucket holds eight packed entries in one cache line:
+//
+//  bits  0-39  key / bucket count (the slot index holds key % bucket count)
+//  bits 40-47  score
+//  bits 48-49  bound type
+//  bits 50-53  best column, 15 if unknown (for the position the key was made from,
+//              callers using mirrored keys mirror the column themselves)
+//  bits 54-61  depth, how much work the entry represents
+//
+//slots 0-6 are depth preferred and slot 7 always takes the newest entry.
+//entries are single 64 bit words read and written atomically, so several search
+//threads can share one table without locks and never see a torn entry.
+//position keys are under 49 bits, so with more than 512 buckets the bucket index and
+//the 40 bit tag together identify a position exactly and lookups never return a
+//different position's entry
+
+namespace ConnectFour
+{
+	enum class Bound : uint8_t
+	{
+		None = 0,
+		Upper = 1,
+		Lower = 2,
+		Exact = 3
+	};
+
+	constexpr int NoMove = 15;
+
+	struct TableEntry
+	{
+		int score;
+		Bound bound;
+		int bestMove;
+		int depth;
+	};
+
+	//kept by each searcher rather than the shared table, so counting is free of contention
+	struct TableStats
+	{
+		uint64_t probes;
+		uint64_t hits;
+		//probes that missed because the bucket was already full of other positions
+		uint64_t collisions;
+		uint64_t stores;
+		//stores that threw out a different position
+		uint64_t overwrites;
+
+		TableStats& operator+=(const TableStats& other) noexcept
+		{
+			probes += other.probes;
+			hits += other.hits;
+			collisions += other.collisions;
+			stores += other.stores;
+			overwrites += other.overwrites;
+			return *this;
+		}
+	};
+
+	class TranspositionTable
+	{
+	public:
+		static constexpr int BucketEntries = 8;
+		static constexpr int AlwaysReplaceSlot = BucketEntries - 1;
+
+		//never allocates more than sizeBytes, except to reach the minimum of 521 buckets
+		explicit TranspositionTable(size_t sizeBytes, bool useHugePages = false) noexcept
+		{
+			allocationBytes = sizeBytes - sizeBytes % sizeof(Bucket);
+
+			//huge pages can only be mapped in whole pages
+			if (useHugePages && sizeBytes >= HugePageSize)
+				allocationBytes = sizeBytes - sizeBytes % HugePageSize;
+
+			if (allocationBytes < MinBuckets * sizeof(Bucket))
+				allocationBytes = MinBuckets * sizeof(Bucket);
+
+			bucketCount = LargestPrimeAtMost(allocationBytes / sizeof(Bucket));
+			buckets = (Bucket*)Allocate(allocationBytes, useHugePages, hugePagesUsed);
+
+			Clear();
+		}
+
+		~TranspositionTable()
+		{
+			Free(buckets, allocationBytes);
+		}
+
+		TranspositionTable(const TranspositionTable&) = delete;
+		TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+		[[nodiscard]]
+		bool Probe(Bitboard key, TableEntry& entry, TableStats& stats) noexcept
+		{
+			const Bucket& bucket = buckets[key % bucketCount];
+			uint64_t tag = (key / bucketCount) & TagMask;
+
+			stats.probes++;
+
+			int occupied = 0;
+
+			for (int i = 0; i < BucketEntries; i++)
+			{
+				uint64_t data = bucket.entries[i].load(std::memory_order_relaxed);
+
+				if ((data & TagMask) == tag && data != 0)
+				{
+					stats.hits++;
+					entry = Unpack(data);
+					return true;
+				}
+
+				occupied += data != 0;
+			}
+
+			if (occupied == BucketEntries)
+				stats.collisions++;
+
+			return false;
+		}
+
+		void Store(Bitboard key, int score, Bound bound, int bestMove, int depth, TableStats& stats) noexcept
+		{
+			Bucket& bucket = buckets[key % bucketCount];
+			uint64_t tag = (key / bucketCount) & TagMask;
+			uint64_t data = Pack(tag, score, bound, bestMove, depth);
+
+			stats.stores++;
+
+			int shallowest = 0;
+			int shallowestDepth = INT32_MAX;
+
+			for (int i = 0; i < AlwaysReplaceSlot; i++)
+			{
+				uint64_t existing = bucket.entries[i].load(std::memory_order_relaxed);
+
+				if (existing == 0 || (existing & TagMask) == tag)
+				{
+					bucket.entries[i].store(data, std::memory_order_relaxed);
+					return;
+				}
+
+				int existingDepth = (int)((existing >> DepthShift) & 0xFF);
+
+				if (existingDepth < shallowestDepth)
+				{
+					shallowestDepth = existingDepth;
+					shallowest = i;
+				}
+			}
+
+			std::atomic<uint64_t>& slot = depth >= shallowestDepth ? bucket.entries[shallowest] : bucket.entries[AlwaysReplaceSlot];
+			uint64_t replaced = slot.load(std::memory_order_relaxed);
+
+			if (replaced != 0 && (replaced & TagMask) != tag)
+				stats.overwrites++;
+
+			slot.store(data, std::memory_order_relaxed);
+		}
+
+		//not safe while a search is running
+		void Clear() noexcept
+		{
+			memset((void*)buckets, 0, allocationBytes);
+		}
+
+		[[nodiscard]]
+		size_t SizeBytes() const noexcept
+		{
+			return allocationBytes;
+		}
+
+		[[nodiscard]]
+		bool UsesHugePages() const noexcept
+		{
+			return hugePagesUsed;
+		}
+
+	private:
+		struct alignas(64) Bucket
+		{
+			std::atomic<uint64_t> entries[BucketEntries];
+		};
+
+		static_assert(sizeof(Bucket) == 64);
+		static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+		static constexpr uint64_t TagMask = (uint64_t(1) << 40) - 1;
+		static constexpr int ScoreShift = 40;
+		static constexpr int BoundShift = 48;
+		static constexpr int MoveShift = 50;
+		static constexpr int DepthShift = 54;
+
+		static constexpr size_t MinBuckets = 521;
+		static constexpr size_t HugePageSize = 2 << 20;
+
+		[[nodiscard]]
+		static uint64_t Pack(uint64_t tag, int score, Bound bound, int bestMove, int depth) noexcept
+		{
+			return
+				tag |
+				((uint64_t)(uint8_t)(int8_t)score << ScoreShift) |
+				((uint64_t)bound << BoundShift) |
+				((uint64_t)(bestMove & 0xF) << MoveShift) |
+				((uint64_t)(depth & 0xFF) << DepthShift);
+		}
+
+		[[nodiscard]]
+		static TableEntry Unpack(uint64_t data) noexcept
+		{
+			return
+			{
+				.score = (int8_t)(uint8_t)(data >> ScoreShift),
+				.bound = (Bound)((data >> BoundShift) & 0x3),
+				.bestMove = (int)((data >> MoveShift) & 0xF),
+				.depth = (int)((data >> DepthShift) & 0xFF)
+			};
+		}
+
+		//a prime bucket count spreads the structured position keys over every bucket
+		[[nodiscard]]
+		static size_t LargestPrimeAtMost(size_t n) noexcept
+		{
+			for (; n > 2; n--)
+			{
+				bool prime = n % 2 != 0;
+
+				for (size_t d = 3; prime && d * d <= n; d += 2)
+					prime = n % d != 0;
+
+				if (prime)
+					return n;
+			}
+
+			return 2;
+		}
+
+		[[nodiscard]]
+		static void* Allocate(size_t bytes, bool useHugePages, bool& hugePagesUsed) noexcept
+		{
+			hugePagesUsed = false;
+
+#ifdef _WIN32
+			if (useHugePages)
+			{
+				//needs SeLockMemoryPrivilege, fall back to normal pages without it
+				size_t largePage = GetLargePageMinimum();
+
+				if (largePage != 0 && bytes % largePage == 0)
+				{
+					void* memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+					if (memory != nullptr)
+					{
+						hugePagesUsed = true;
+						return memory;
+					}
+				}
+			}
+
+			void* memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+			if (memory == nullptr)
+				abort();
+
+			return memory;
+#else
+#ifdef MAP_HUGETLB
+			if (useHugePages && bytes % HugePageSize == 0)
+			{
+				void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+				if (memory != MAP_FAILED)
+				{
+					hugePagesUsed = true;
+					return memory;
+				}
+			}
+#endif
+
+			void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if (memory == MAP_FAILED)
+				abort();
+
+#ifdef MADV_HUGEPAGE
+			//no reserved huge pages, ask for transparent ones instead
+			if (useHugePages)
+				madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+
+			return memory;
+#endif
+		}
+
+		static void Free(void* memory, size_t bytes) noexcept
+		{
+#ifdef _WIN32
+			(void)bytes;
+			VirtualFree(memory, 0, MEM_RELEASE);
+#else
+			munmap(memory, bytes);
+#endif
+		}
+
+		Bucket* buckets = nullptr;
+		size_t bucketCount = 0;
+		size_t allocationBytes = 0;
+		bool hugePagesUsed = false;
+	};
+}
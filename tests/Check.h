@@ -0,0 +1,34 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+//the tests are plain programs: every failed CHECK is printed with its line, and main() ends
+//with TestResult(), which exits with failure if any check failed
+
+inline int checkFailures = 0;
+inline int checkCount = 0;
+
+#define CHECK(x) \
+	do \
+	{ \
+		checkCount++; \
+		if (!(x)) \
+		{ \
+			checkFailures++; \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+		} \
+	} while (false)
+
+[[nodiscard]]
+inline int TestResult(const char* name) noexcept
+{
+	printf("%s: %d checks, %d failed\n", name, checkCount, checkFailures);
+	return checkFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
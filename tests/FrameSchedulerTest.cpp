@@ -0,0 +1,152 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//the frame scheduler against a clock the test moves by hand
+//
+//build: g++ -std=c++20 -O2 tests/FrameSchedulerTest.cpp -o FrameSchedulerTest
+
+#include <chrono>
+
+#include "Check.h"
+#include "../ConnectFourFrameScheduler.h"
+
+using namespace std::chrono_literals;
+
+struct FakeClock
+{
+	using duration = std::chrono::nanoseconds;
+	using time_point = std::chrono::time_point<FakeClock, duration>;
+
+	//shared by every copy, the scheduler keeps its own
+	time_point* time;
+
+	[[nodiscard]]
+	time_point now() const noexcept
+	{
+		return *time;
+	}
+};
+
+using Scheduler = ConnectFour::BasicFrameScheduler<FakeClock>;
+
+static void FirstFrame()
+{
+	FakeClock::time_point time{ 1s };
+	Scheduler scheduler(FakeClock{ &time });
+
+	//nothing has been drawn yet
+	CHECK(scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == Scheduler::Duration::zero());
+}
+
+static void Idle()
+{
+	FakeClock::time_point time{ 1s };
+	Scheduler scheduler(FakeClock{ &time });
+
+	scheduler.BeginFrame();
+
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == (Scheduler::Duration::max)());
+
+	//no amount of waiting makes a frame due
+	time += 1h;
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == (Scheduler::Duration::max)());
+}
+
+static void Dirty()
+{
+	FakeClock::time_point time{ 1s };
+	Scheduler scheduler(FakeClock{ &time });
+
+	scheduler.BeginFrame();
+	scheduler.Invalidate();
+
+	CHECK(scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == Scheduler::Duration::zero());
+
+	//invalidating wins over a later deadline
+	scheduler.RequestFrameAt(time + 1s);
+	CHECK(scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == Scheduler::Duration::zero());
+
+	//drawing takes care of both
+	scheduler.BeginFrame();
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == (Scheduler::Duration::max)());
+}
+
+static void Deadline()
+{
+	FakeClock::time_point time{ 1s };
+	Scheduler scheduler(FakeClock{ &time });
+
+	scheduler.BeginFrame();
+	scheduler.RequestFrameAt(time + 100ms);
+
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == 100ms);
+
+	//the earliest request wins
+	scheduler.RequestFrameAt(time + 300ms);
+	CHECK(scheduler.TimeUntilFrame() == 100ms);
+
+	scheduler.RequestFrameAt(time + 40ms);
+	CHECK(scheduler.TimeUntilFrame() == 40ms);
+
+	time += 39ms;
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == 1ms);
+
+	//due from the deadline on, and never a negative wait when it is late
+	time += 1ms;
+	CHECK(scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == Scheduler::Duration::zero());
+
+	time += 1s;
+	CHECK(scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == Scheduler::Duration::zero());
+
+	scheduler.BeginFrame();
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == (Scheduler::Duration::max)());
+}
+
+static void AnimationFrame()
+{
+	FakeClock::time_point time{ 1s };
+	Scheduler scheduler(FakeClock{ &time }, 10ms);
+
+	scheduler.BeginFrame();
+
+	//drawing took 3 ms, the next frame is still one interval after the last one began
+	time += 3ms;
+	scheduler.RequestAnimationFrame();
+
+	CHECK(!scheduler.FrameDue());
+	CHECK(scheduler.TimeUntilFrame() == 7ms);
+
+	time += 7ms;
+	CHECK(scheduler.FrameDue());
+
+	//a frame begun late sets the next one from when it began
+	time += 5ms;
+	scheduler.BeginFrame();
+	scheduler.RequestAnimationFrame();
+	CHECK(scheduler.TimeUntilFrame() == 10ms);
+}
+
+int main()
+{
+	FirstFrame();
+	Idle();
+	Dirty();
+	Deadline();
+	AnimationFrame();
+
+	return TestResult("FrameSchedulerTest");
+}
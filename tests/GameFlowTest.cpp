@@ -0,0 +1,308 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//the game flow reducer run on scripted input and a scripted clock
+//
+//build: g++ -std=c++20 -O2 tests/GameFlowTest.cpp -o GameFlowTest
+
+#include <chrono>
+#include <iterator>
+
+#include "Check.h"
+#include "../ConnectFourGameFlow.h"
+
+using namespace ConnectFour;
+using namespace std::chrono_literals;
+
+//round numbers: a piece crosses 10 rows a second
+constexpr GameTiming Timing = { .fallRowsPerSecond = 10, .gameOverDuration = 1s, .blinkPeriod = 150ms };
+
+[[nodiscard]]
+static GameState Step(const GameState& state, const GameInput& input, std::chrono::nanoseconds now)
+{
+	return StepGame(state, input, now, Timing);
+}
+
+[[nodiscard]]
+static GameState Idle(const GameState& state, std::chrono::nanoseconds now)
+{
+	return Step(state, {}, now);
+}
+
+[[nodiscard]]
+static GameInput Click(int column)
+{
+	return { .column = column, .click = true };
+}
+
+[[nodiscard]]
+static GameInput CPU(int column)
+{
+	return { .cpuColumn = column };
+}
+
+//drops a piece with input at now and steps until it lands, returns the landing time
+static std::chrono::nanoseconds Drop(GameState& state, const GameInput& input, std::chrono::nanoseconds now)
+{
+	state = Step(state, input, now);
+
+	while (state.phase == GamePhase::PieceFalling)
+	{
+		now += 10ms;
+		state = Idle(state, now);
+	}
+
+	return now;
+}
+
+[[nodiscard]]
+static GameState Playing()
+{
+	return Step({}, { .button = MenuButton::Play, .click = true }, 0s);
+}
+
+static void Menu()
+{
+	GameState state;
+	CHECK(state.phase == GamePhase::Menu);
+
+	//hovering or clicking beside the buttons does nothing
+	state = Step(state, { .button = MenuButton::Play }, 1ms);
+	CHECK(state.phase == GamePhase::Menu);
+	CHECK(state.events == 0);
+
+	state = Step(state, { .click = true }, 2ms);
+	CHECK(state.phase == GamePhase::Menu);
+
+	GameState exit = Step(state, { .button = MenuButton::Exit, .click = true }, 3ms);
+	CHECK(exit.phase == GamePhase::Menu);
+	CHECK(exit.events == EventExit);
+
+	state = Step(state, { .button = MenuButton::Play, .click = true }, 4ms);
+	CHECK(state.phase == GamePhase::PlayerTurn);
+	CHECK(state.board.MoveCount() == 0);
+
+	//waiting for input needs no frames
+	CHECK(NextGameChange(state, 5ms, Timing) == (std::chrono::nanoseconds::max)());
+}
+
+static void FallTiming()
+{
+	GameState state = Playing();
+
+	//clicks beside the board are ignored
+	state = Step(state, Click(-1), 10ms);
+	CHECK(state.phase == GamePhase::PlayerTurn);
+
+	state = Step(state, Click(3), 100ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+	CHECK(state.events == EventPlayerMoved);
+	CHECK(state.fallingPiece == 1);
+	CHECK(state.fallingColumn == 3);
+	CHECK(state.fallingTargetRow == Height - 1);
+	CHECK(state.fallingRow == -1);
+	CHECK(NextGameChange(state, 100ms, Timing) == 100ms);
+
+	//row = seconds * 10 - 1, so the bottom row's center is passed after 0.6 s
+	state = Idle(state, 350ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+	CHECK(state.fallingRow > 1.49f && state.fallingRow < 1.51f);
+
+	state = Idle(state, 690ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+	CHECK(state.board.MoveCount() == 0);
+
+	state = Idle(state, 710ms);
+	CHECK(state.phase == GamePhase::CPUTurn);
+	CHECK(state.events == 0);
+	CHECK(state.board.MoveCount() == 1);
+	CHECK(state.board.ColumnHeight(3) == 1);
+	CHECK(state.record.moveCount == 1 && state.record.moves[0] == 3);
+
+	//the CPU's turn waits for its move, but asks to be stepped at once
+	CHECK(NextGameChange(state, 720ms, Timing) == 720ms);
+	state = Idle(state, 720ms);
+	CHECK(state.phase == GamePhase::CPUTurn);
+
+	//a full column or one off the board is no move
+	state = Step(state, CPU(Width), 730ms);
+	CHECK(state.phase == GamePhase::CPUTurn);
+
+	//the second piece has one row less to fall: 0.5 s
+	state = Step(state, CPU(3), 1000ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+	CHECK(state.events == EventCPUMoved);
+	CHECK(state.fallingPiece == 2);
+	CHECK(state.fallingTargetRow == Height - 2);
+
+	state = Idle(state, 1490ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+
+	state = Idle(state, 1510ms);
+	CHECK(state.phase == GamePhase::PlayerTurn);
+	CHECK(state.board.ColumnHeight(3) == 2);
+	CHECK(state.board.PlayerStones(0) == CellBit(3, 0));
+}
+
+//the same clicks at the same times give the same game at any frame rate
+static void FrameRateIndependent()
+{
+	GameState results[2];
+	std::chrono::nanoseconds steps[2] = { 1ms, 33ms };
+
+	for (int run = 0; run < 2; run++)
+	{
+		GameState state = Playing();
+		int nextMove = 0;
+		constexpr int Moves[] = { 3, 2, 3, 4, 5, 1, 0, 6 };
+
+		for (std::chrono::nanoseconds now = 0s; now < 10s; now += steps[run])
+		{
+			GameInput input;
+
+			//a move every second, on the first frame at or after it
+			if (nextMove < (int)std::size(Moves) && now >= nextMove * 1s)
+			{
+				if (state.phase == GamePhase::PlayerTurn)
+					input = Click(Moves[nextMove++]);
+				else if (state.phase == GamePhase::CPUTurn)
+					input = CPU(Moves[nextMove++]);
+			}
+
+			state = Step(state, input, now);
+		}
+
+		results[run] = state;
+	}
+
+	CHECK(results[0].phase == GamePhase::PlayerTurn);
+	CHECK(results[0].phase == results[1].phase);
+	CHECK(results[0].board.MoveCount() == 8);
+	CHECK(results[0].board.Key() == results[1].board.Key());
+	CHECK(results[0].record.moveCount == results[1].record.moveCount);
+}
+
+static void WinAndBlink()
+{
+	GameState state = Playing();
+	std::chrono::nanoseconds now = 0s;
+
+	//the player stacks column 0, the CPU column 1
+	for (int i = 0; i < 3; i++)
+	{
+		now = Drop(state, Click(0), now + 10ms);
+		CHECK(state.phase == GamePhase::CPUTurn);
+
+		now = Drop(state, CPU(1), now + 10ms);
+		CHECK(state.phase == GamePhase::PlayerTurn);
+	}
+
+	CHECK(state.winningPieces == 0);
+
+	state = Step(state, Click(0), now + 10ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+
+	//steps until the fourth stone lands
+	while (state.phase == GamePhase::PieceFalling)
+	{
+		now += 1ms;
+		state = Idle(state, now);
+	}
+
+	std::chrono::nanoseconds landed = now;
+
+	CHECK(state.phase == GamePhase::GameOver);
+	CHECK(state.events == EventGameFinished);
+	CHECK(state.playerScore == 1);
+	CHECK(state.cpuScore == 0);
+	CHECK(state.record.moveCount == 7);
+	CHECK(state.record.result == GameResult::FirstPlayerWin);
+	CHECK(state.winningPieces == (CellBit(0, 0) | CellBit(0, 1) | CellBit(0, 2) | CellBit(0, 3)));
+	CHECK(state.gameOverUntil == landed + Timing.gameOverDuration);
+
+	//clicks do nothing while the win is shown
+	state = Step(state, Click(2), landed + 5ms);
+	CHECK(state.phase == GamePhase::GameOver);
+
+	//lit while the time left % 150 ms is under 75 ms: 990 ms left is 90, so it lights after 15 ms more
+	state = Idle(state, landed + 10ms);
+	CHECK(!state.highlightWinningPieces);
+
+	std::chrono::nanoseconds flip = NextGameChange(state, landed + 10ms, Timing);
+	CHECK(flip == landed + 25ms + 1ns);
+
+	state = Idle(state, flip - 2ns);
+	CHECK(!state.highlightWinningPieces);
+
+	state = Idle(state, flip);
+	CHECK(state.highlightWinningPieces);
+
+	//and goes dark again 75 ms later
+	CHECK(NextGameChange(state, flip, Timing) == landed + 100ms + 1ns);
+
+	state = Idle(state, landed + 100ms + 1ns);
+	CHECK(!state.highlightWinningPieces);
+
+	//the win is shown for gameOverDuration, then the next game starts with the scores kept
+	state = Idle(state, landed + 1s);
+	CHECK(state.phase == GamePhase::GameOver);
+
+	state = Idle(state, landed + 1s + 1ns);
+	CHECK(state.phase == GamePhase::PlayerTurn);
+	CHECK(state.board.MoveCount() == 0);
+	CHECK(state.winningPieces == 0);
+	CHECK(!state.highlightWinningPieces);
+	CHECK(state.playerScore == 1);
+
+	//the finished game was reported once, the step after drops it
+	CHECK(state.record.moveCount == 0);
+	CHECK(state.events == 0);
+}
+
+static void Escape()
+{
+	GameState state = Playing();
+	std::chrono::nanoseconds now = Drop(state, Click(4), 10ms);
+	now = Drop(state, CPU(2), now + 10ms);
+
+	state.playerScore = 3;
+	state.cpuScore = 2;
+
+	//escape while a piece falls, the falling piece is not part of the record yet
+	state = Step(state, Click(4), now + 10ms);
+	CHECK(state.phase == GamePhase::PieceFalling);
+
+	state = Step(state, { .escape = true }, now + 20ms);
+	CHECK(state.phase == GamePhase::Menu);
+	CHECK(state.events == EventGameLeft);
+	CHECK(state.board.MoveCount() == 0);
+	CHECK(state.playerScore == 0 && state.cpuScore == 0);
+	CHECK(state.record.result == GameResult::Unfinished);
+	CHECK(state.record.moveCount == 2);
+	CHECK(state.record.moves[0] == 4 && state.record.moves[1] == 2);
+
+	//the abandoned game was reported once
+	state = Idle(state, now + 30ms);
+	CHECK(state.phase == GamePhase::Menu);
+	CHECK(state.record.moveCount == 0);
+	CHECK(state.events == 0);
+
+	//escape on the menu reports an empty game
+	state = Step(state, { .escape = true }, now + 40ms);
+	CHECK(state.events == EventGameLeft);
+	CHECK(state.record.moveCount == 0);
+}
+
+int main()
+{
+	Menu();
+	FallTiming();
+	FrameRateIndependent();
+	WinAndBlink();
+	Escape();
+
+	return TestResult("GameFlowTest");
+}
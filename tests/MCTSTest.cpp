@@ -0,0 +1,151 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//monte carlo tree search under tight limits and on several threads
+//
+//build: g++ -std=c++20 -O2 -pthread tests/MCTSTest.cpp -o MCTSTest
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include "Check.h"
+#include "../ConnectFourMCTS.h"
+
+using namespace ConnectFour;
+
+//every allocation, to check that searching allocates nothing once the helpers are running
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+
+	if (void* memory = malloc(size == 0 ? 1 : size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+[[nodiscard]]
+static bool Playable(const Position& position, int column) noexcept
+{
+	return column >= 0 && column < Width && position.CanPlay(column);
+}
+
+//a deadline that has already passed still gets a move from one playout
+static void PassedDeadline()
+{
+	for (int threads : { 1, 4 })
+	{
+		MCTS mcts(1, threads);
+
+		MCTSResult result = mcts.Search(Position(), { .deadline = std::chrono::steady_clock::now() });
+		CHECK(Playable(Position(), result.column));
+		CHECK(result.playouts >= 1);
+		CHECK(result.nodes > 1);
+
+		Position position;
+		position.Play(3);
+		position.Play(3);
+
+		result = mcts.Search(position, { .deadline = std::chrono::steady_clock::time_point() });
+		CHECK(Playable(position, result.column));
+		CHECK(result.playouts >= 1);
+	}
+}
+
+static void ZeroPlayouts()
+{
+	MCTS mcts;
+
+	MCTSResult result = mcts.Search(Position(), { .playouts = 0 });
+	CHECK(Playable(Position(), result.column));
+	CHECK(result.playouts == 1);
+	CHECK(result.nodes == Width + 1);
+}
+
+static void PlayoutBudget()
+{
+	MCTS mcts;
+
+	MCTSResult result = mcts.Search(Position(), { .playouts = 1000 });
+	CHECK(Playable(Position(), result.column));
+	CHECK(result.playouts == 1000);
+	CHECK(result.value >= 0 && result.value <= 1);
+}
+
+//a full board has no move, a win in one is taken without searching
+static void NoSearchNeeded()
+{
+	MCTS mcts;
+
+	Position full;
+
+	for (int x = 0; x < Width; x++)
+	{
+		for (int y = 0; y < Height; y++)
+			full.Play((x + (y / 2) * 2) % Width);
+	}
+
+	CHECK(full.IsFull());
+	CHECK(mcts.Search(full, { .playouts = 100 }).column == -1);
+
+	Position threat;
+
+	for (int column : { 0, 1, 0, 1, 0, 1 })
+		threat.Play(column);
+
+	MCTSResult result = mcts.Search(threat, { .deadline = std::chrono::steady_clock::now() });
+	CHECK(result.column == 0);
+	CHECK(result.playouts == 0);
+}
+
+//the helpers are kept from one search to the next, so only the first search allocates
+static void RepeatedSearches()
+{
+	MCTS mcts(1, 4);
+
+	Position position;
+	CHECK(Playable(position, mcts.Search(position, { .playouts = 2000 }).column));
+
+	size_t before = allocations;
+
+	for (int i = 0; i < 20; i++)
+	{
+		MCTSResult result = mcts.Search(position, { .playouts = 2000 });
+		CHECK(Playable(position, result.column));
+		CHECK(result.playouts == 2000);
+
+		position.Play(result.column);
+
+		if (position.CanWinNext() || position.MoveCount() > 10)
+			position = Position();
+	}
+
+	CHECK(allocations == before);
+}
+
+int main()
+{
+	PassedDeadline();
+	ZeroPlayouts();
+	PlayoutBudget();
+	NoSearchNeeded();
+	RepeatedSearches();
+
+	return TestResult("MCTSTest");
+}
@@ -0,0 +1,294 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//the scene's diffing and draw commands, checked without a window
+//
+//build: g++ -std=c++20 -O2 tests/SceneTest.cpp -o SceneTest
+//
+//a small software canvas plays draw lists the way the game's Direct2D backend does, at one
+//sample a pixel, and random games are drawn twice: once through the partial repaints of one
+//scene and once by redrawing another scene in full every frame. the two canvases have to be
+//identical after every frame
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "../ConnectFourScene.h"
+
+using namespace ConnectFour;
+using namespace std::chrono_literals;
+
+class Canvas
+{
+public:
+	Canvas(int width, int height) :
+		width(width),
+		height(height),
+		pixels((size_t)width * height, 0)
+	{
+	}
+
+	[[nodiscard]]
+	const std::vector<uint32_t>& Pixels() const noexcept
+	{
+		return pixels;
+	}
+
+	void Play(const DrawList& drawList, const SceneLayout& layout) noexcept
+	{
+		SceneRect clip = { .left = 0, .top = 0, .right = (float)width, .bottom = (float)height };
+		SceneRect window = clip;
+
+		for (int i = 0; i < drawList.count; i++)
+		{
+			const DrawCommand& command = drawList.commands[i];
+
+			switch (command.op)
+			{
+			case DrawOp::PushClip:
+				clip = command.rect;
+				break;
+			case DrawOp::PopClip:
+				clip = window;
+				break;
+			case DrawOp::Clear:
+				Fill(clip, clip, [](float, float) { return true; }, 0);
+				break;
+			case DrawOp::FillRectangle:
+				Fill(command.rect, clip, [](float, float) { return true; }, Color(command));
+				break;
+			case DrawOp::FillEllipse:
+			{
+				const SceneRect& rect = command.rect;
+				float centerX = (rect.left + rect.right) / 2;
+				float centerY = (rect.top + rect.bottom) / 2;
+				float radius = (rect.right - rect.left) / 2;
+
+				Fill(rect, clip, [&](float x, float y)
+				{
+					return (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY) <= radius * radius;
+				}, Color(command));
+				break;
+			}
+			case DrawOp::FillBoard:
+				Fill(command.rect, clip, [&](float x, float y)
+				{
+					int column = (int)((x - layout.board.left) * layout.columnsPerPixel);
+					int row = (int)((y - layout.board.top) / layout.squareSize);
+
+					if (column >= Width || row >= Height)
+						return true;
+
+					ScenePoint center = layout.CellCenter(column, row);
+					return (x - center.x) * (x - center.x) + (y - center.y) * (y - center.y) >= layout.holeRadius * layout.holeRadius;
+				}, Color(command));
+				break;
+			case DrawOp::Text:
+				//the text's bounds in a color made from the text, so a stale score shows
+				Fill(command.rect, clip, [](float, float) { return true; }, Color(command));
+				break;
+			}
+		}
+	}
+
+private:
+	int width;
+	int height;
+	std::vector<uint32_t> pixels;
+
+	[[nodiscard]]
+	static uint32_t Color(const DrawCommand& command) noexcept
+	{
+		uint32_t color = (uint32_t)command.brush * 7919 + 1;
+
+		if (command.op == DrawOp::Text)
+		{
+			for (int i = 0; i < command.textLength; i++)
+				color = color * 31 + (uint32_t)command.text[i];
+		}
+
+		return color | 1;
+	}
+
+	//every pixel whose center is inside rect, clip and the shape
+	template<typename Shape>
+	void Fill(const SceneRect& rect, const SceneRect& clip, const Shape& inside, uint32_t color) noexcept
+	{
+		for (int y = 0; y < height; y++)
+		{
+			float centerY = y + .5f;
+
+			if (centerY < rect.top || centerY >= rect.bottom || centerY < clip.top || centerY >= clip.bottom)
+				continue;
+
+			for (int x = 0; x < width; x++)
+			{
+				float centerX = x + .5f;
+
+				if (centerX < rect.left || centerX >= rect.right || centerX < clip.left || centerX >= clip.right)
+					continue;
+
+				if (inside(centerX, centerY))
+					pixels[(size_t)y * width + x] = color;
+			}
+		}
+	}
+};
+
+static int CountOps(const DrawList& drawList, DrawOp op)
+{
+	int count = 0;
+
+	for (int i = 0; i < drawList.count; i++)
+		count += drawList.commands[i].op == op;
+
+	return count;
+}
+
+//regions are padded out past the window's edges
+static bool CoversWindow(const SceneRect& rect, int width, int height)
+{
+	return rect.left <= 0 && rect.top <= 0 && rect.right >= width && rect.bottom >= height;
+}
+
+static void Commands()
+{
+	Scene scene;
+	scene.Resize(480, 480);
+
+	GameState game = StepGame({}, { .button = MenuButton::Play, .click = true }, 0s);
+
+	//the first frame is one region over the whole window
+	const DrawList& first = scene.Update(game, -1);
+	CHECK(first.count > 0);
+	CHECK(first.commands[0].op == DrawOp::PushClip);
+	CHECK(CoversWindow(first.commands[0].rect, 480, 480));
+	CHECK(CountOps(first, DrawOp::PushClip) == 1);
+	CHECK(CountOps(first, DrawOp::FillBoard) == 1);
+	CHECK(CountOps(first, DrawOp::Text) == 4);
+
+	//nothing changed, nothing to draw
+	CHECK(scene.Update(game, -1).count == 0);
+
+	//a piece over a column repaints around it, the board in front of it included
+	const DrawList& hover = scene.Update(game, 3);
+	CHECK(CountOps(hover, DrawOp::PushClip) == 1);
+	CHECK(CountOps(hover, DrawOp::FillEllipse) == 1);
+	CHECK(hover.commands[0].rect.right - hover.commands[0].rect.left < 480 / 2);
+
+	CHECK(scene.Update(game, 3).count == 0);
+
+	//moving to another column repaints where the piece was and where it is
+	const DrawList& moved = scene.Update(game, 5);
+	CHECK(CountOps(moved, DrawOp::PushClip) == 2);
+	CHECK(CountOps(moved, DrawOp::PopClip) == 2);
+
+	//clip regions are whole pixels
+	for (int i = 0; i < moved.count; i++)
+	{
+		if (moved.commands[i].op != DrawOp::PushClip)
+			continue;
+
+		const SceneRect& rect = moved.commands[i].rect;
+		CHECK(rect.left == (int)rect.left && rect.top == (int)rect.top && rect.right == (int)rect.right && rect.bottom == (int)rect.bottom);
+	}
+
+	//a score change repaints the score and nothing on the board
+	(void)scene.Update(game, -1);
+	game.playerScore = 12;
+
+	const DrawList& score = scene.Update(game, -1);
+	CHECK(CountOps(score, DrawOp::PushClip) == 1);
+	CHECK(CountOps(score, DrawOp::FillBoard) == 0);
+	CHECK(score.commands[0].rect.bottom <= scene.Layout().board.top);
+
+	bool found = false;
+
+	for (int i = 0; i < score.count; i++)
+	{
+		const DrawCommand& command = score.commands[i];
+
+		if (command.op == DrawOp::Text && command.textLength == 2 && command.text[0] == L'1' && command.text[1] == L'2')
+			found = true;
+	}
+
+	CHECK(found);
+
+	//a lost target is redrawn in full
+	scene.Invalidate();
+	CHECK(CoversWindow(scene.Update(game, -1).commands[0].rect, 480, 480));
+}
+
+//random games drawn by partial repaints and by full redraws have to match pixel for pixel
+static void PartialMatchesFull(int size, uint64_t seed, int frames)
+{
+	Scene partial;
+	Scene full;
+	partial.Resize(size, size);
+	full.Resize(size, size);
+
+	Canvas partialCanvas(size, size);
+	Canvas fullCanvas(size, size);
+
+	std::mt19937_64 rng(seed);
+	GameState game;
+	std::chrono::nanoseconds now{};
+
+	int mismatches = 0;
+	int drawn = 0;
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		uint64_t random = rng();
+
+		GameInput input =
+		{
+			.column = (int)(random % (Width + 1)) - 1,
+			.button = MenuButton::Play,
+			.click = (random >> 8) % 6 == 0,
+			.escape = (random >> 20) % 2000 == 0,
+			.cpuColumn = (int)((random >> 40) % Width)
+		};
+
+		game = StepGame(game, input, now);
+		now += 16667us;
+
+		//the menu is drawn by the window, not the scene
+		if (game.phase == GamePhase::Menu)
+		{
+			partial.Invalidate();
+			continue;
+		}
+
+		partialCanvas.Play(partial.Update(game, input.column), partial.Layout());
+
+		full.Invalidate();
+		fullCanvas.Play(full.Update(game, input.column), full.Layout());
+
+		drawn++;
+
+		if (partialCanvas.Pixels() != fullCanvas.Pixels())
+			mismatches++;
+	}
+
+	CHECK(drawn > frames / 2);
+	CHECK(mismatches == 0);
+}
+
+int main()
+{
+	Commands();
+	PartialMatchesFull(480, 3, 3000);
+
+	//sizes where the layout falls between pixels
+	PartialMatchesFull(301, 5, 1000);
+	PartialMatchesFull(577, 7, 1000);
+
+	return TestResult("SceneTest");
+}